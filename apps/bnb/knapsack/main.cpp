@@ -12,12 +12,15 @@
 #include "knapsack.hpp"
 
 #include "YewPar.hpp"
+#include "util/Batch.hpp"
+#include "util/Service.hpp"
 #include "util/func.hpp"
 #include "skeletons/Seq.hpp"
 #include "skeletons/DepthBounded.hpp"
 #include "skeletons/Ordered.hpp"
 #include "skeletons/Budget.hpp"
 #include "skeletons/StackStealing.hpp"
+#include "skeletons/BestFirst.hpp"
 
 #ifndef NUMITEMS
 #define NUMITEMS 50
@@ -66,16 +69,14 @@ knapsackData read_knapsack(const std::string & filename) {
   return kp;
 }
 
-int hpx_main(hpx::program_options::variables_map & opts) {
-
-
+// Solve a single instance and print the result to out
+int solve(hpx::program_options::variables_map & opts, const std::string & inputFile,
+          std::ostream & out) {
   knapsackData problem;
-  auto inputFile = opts["input-file"].as<std::string>();
   try {
     problem = read_knapsack(inputFile);
   } catch (std::string e) {
-    hpx::cout << "Error in file parsing" << std::endl;
-    hpx::finalize();
+    out << "Error in file parsing" << std::endl;
     return EXIT_FAILURE;
   }
 
@@ -117,8 +118,7 @@ int hpx_main(hpx::program_options::variables_map & opts) {
     auto x = (double) profits[i + 1] / (double) weights[i + 1];
     auto y = (double) profits[i] / (double) weights[i];
     if (x > y) {
-      hpx::cout << "Input not in profit density ordering" << std::endl;
-      hpx::finalize();
+      out << "Input not in profit density ordering" << std::endl;
       return EXIT_FAILURE;
     }
   }
@@ -177,9 +177,14 @@ int hpx_main(hpx::program_options::variables_map & opts) {
                                            YewPar::Skeletons::API::PruneLevel,
                                            YewPar::Skeletons::API::BoundFunction<bnd_func> >
         ::search(space, root, searchParameters);
+  } else if (skeletonType == "bestfirst") {
+    sol = YewPar::Skeletons::BestFirst<GenNode<NUMITEMS>,
+                                       YewPar::Skeletons::API::Optimisation,
+                                       YewPar::Skeletons::API::PruneLevel,
+                                       YewPar::Skeletons::API::BoundFunction<bnd_func> >
+        ::search(space, root);
   } else {
-    hpx::cout << "Invalid skeleton type\n";
-    hpx::finalize();
+    out << "Invalid skeleton type\n";
     return EXIT_FAILURE;
   }
 
@@ -187,33 +192,42 @@ int hpx_main(hpx::program_options::variables_map & opts) {
                       (std::chrono::steady_clock::now() - start_time);
 
   auto finalSol = sol.sol;
-  hpx::cout << "Final Profit: " << finalSol.profit << std::endl;
-  hpx::cout << "Final Weight: " << finalSol.weight << std::endl;
-  hpx::cout << "Expected Result: " << std::boolalpha << (finalSol.profit == problem.expectedResult) << std::endl;
-  hpx::cout << "Items: ";
+  out << "Final Profit: " << finalSol.profit << std::endl;
+  out << "Final Weight: " << finalSol.weight << std::endl;
+  out << "Expected Result: " << std::boolalpha << (finalSol.profit == problem.expectedResult) << std::endl;
+  out << "Items: ";
   for (auto const & i : finalSol.items) {
-    hpx::cout << i << " ";
+    out << i << " ";
   }
-  hpx::cout << std::endl;
+  out << std::endl;
 
-  hpx::cout << "cpu = " << overall_time.count() << std::endl;
+  out << "cpu = " << overall_time.count() << std::endl;
 
-  return hpx::finalize();
+  return EXIT_SUCCESS;
 }
 
-int main(int argc, char* argv[]) {
+// Options for a single search, also used to parse jobs when serving
+hpx::program_options::options_description searchOptions() {
   hpx::program_options::options_description
     desc_commandline("Usage: " HPX_APPLICATION_STRING " [options]");
 
   desc_commandline.add_options()
     ( "skeleton",
       hpx::program_options::value<std::string>()->default_value("seq"),
-      "Which skeleton to use: seq, depthbound, stacksteal, budget, or ordered"
+      "Which skeleton to use: seq, depthbound, stacksteal, budget, ordered, or bestfirst"
     )
     ( "input-file,f",
-      hpx::program_options::value<std::string>()->required(),
+      hpx::program_options::value<std::string>(),
       "Input problem"
     )
+    ( "batch",
+      hpx::program_options::value<std::string>(),
+      "Solve every problem in a directory, or listed in a file (one per line), in one run"
+    )
+    ( "serve",
+      hpx::program_options::value<std::string>(),
+      "Serve search jobs on this Unix domain socket until asked to shut down"
+    )
     ( "backtrack-budget,b",
       hpx::program_options::value<unsigned>()->default_value(500),
       "Number of backtracks before spawning work"
@@ -224,6 +238,43 @@ int main(int argc, char* argv[]) {
       "Depth in the tree to spawn until (for parallel skeletons only)"
     );
 
+  return desc_commandline;
+}
+
+int hpx_main(hpx::program_options::variables_map & opts) {
+  int res;
+  if (opts.count("serve")) {
+    res = YewPar::Service::serve(opts["serve"].as<std::string>(), searchOptions(),
+                                 [](hpx::program_options::variables_map & job, std::ostream & out) {
+      if (!job.count("input-file")) {
+        out << "Expected an input problem (--input-file)" << std::endl;
+        return EXIT_FAILURE;
+      }
+      return solve(job, job["input-file"].as<std::string>(), out);
+    });
+  } else if (opts.count("batch")) {
+    auto instances = YewPar::Batch::findInstances(opts["batch"].as<std::string>());
+    res = YewPar::Batch::run(instances, [&](const YewPar::Batch::Instance & inst) {
+      if (inst.size() != 1) {
+        hpx::cout << "Expected one problem file per instance" << std::endl;
+        return EXIT_FAILURE;
+      }
+      return solve(opts, inst[0], hpx::cout);
+    });
+  } else if (opts.count("input-file")) {
+    res = solve(opts, opts["input-file"].as<std::string>(), hpx::cout);
+  } else {
+    std::cerr << "You must provide an input problem (--input-file) or a batch (--batch)" << std::endl;
+    res = EXIT_FAILURE;
+  }
+
+  hpx::finalize();
+  return res;
+}
+
+int main(int argc, char* argv[]) {
+  auto desc_commandline = searchOptions();
+
   YewPar::registerPerformanceCounters();
 
   hpx::init_params args;
@@ -23,7 +23,11 @@
 #include "skeletons/StackStealing.hpp"
 #include "skeletons/Ordered.hpp"
 #include "skeletons/Budget.hpp"
+#include "skeletons/Indexed.hpp"
+#include "skeletons/Hybrid.hpp"
 
+#include "util/Batch.hpp"
+#include "util/Service.hpp"
 #include "util/func.hpp"
 #include "util/NodeGenerator.hpp"
 
@@ -196,19 +200,9 @@ int upperBound(const BitGraph<NWORDS> & space, const MCNode & n) {
 typedef func<decltype(&upperBound), &upperBound> upperBound_func;
 
 
-int hpx_main(hpx::program_options::variables_map & opts) {
-  /*
-  if (!opts.count("input-file")) {
-    std::cerr << "You must provide an DIMACS input file with \n";
-    hpx::finalize();
-    return EXIT_FAILURE;
-  }
-  */
-
-  //hpx::program_options::notify(opts);
-
-  auto inputFile = opts["input-file"].as<std::string>();
-
+// Solve a single instance and print the result to out
+int solve(hpx::program_options::variables_map & opts, const std::string & inputFile,
+          std::ostream & out) {
   auto gFile = dimacs::read_dimacs(inputFile);
 
   // Order the graph (keep a hold of the map)
@@ -254,6 +248,7 @@ int hpx_main(hpx::program_options::variables_map & opts) {
       YewPar::Skeletons::API::Params<int> searchParameters;
       searchParameters.expectedObjective = decisionBound;
       searchParameters.spawnDepth = spawnDepth;
+      searchParameters.autoSpawnDepth = static_cast<bool>(opts.count("auto-spawn-depth"));
       sol = YewPar::Skeletons::DepthBounded<GenNode,
                                            YewPar::Skeletons::API::Decision,
                                            YewPar::Skeletons::API::BoundFunction<upperBound_func>,
@@ -262,6 +257,7 @@ int hpx_main(hpx::program_options::variables_map & opts) {
     } else {
       YewPar::Skeletons::API::Params<int> searchParameters;
       searchParameters.spawnDepth = spawnDepth;
+      searchParameters.autoSpawnDepth = static_cast<bool>(opts.count("auto-spawn-depth"));
       auto poolType = opts["poolType"].as<std::string>();
       if (poolType == "deque") {
         sol = YewPar::Skeletons::DepthBounded<GenNode,
@@ -271,6 +267,14 @@ int hpx_main(hpx::program_options::variables_map & opts) {
                                              YewPar::Skeletons::API::DepthBoundedPoolPolicy<
                                                Workstealing::Policies::Workpool> >
             ::search(graph, root, searchParameters);
+      } else if (poolType == "workerdeques") {
+        sol = YewPar::Skeletons::DepthBounded<GenNode,
+                                             YewPar::Skeletons::API::Optimisation,
+                                             YewPar::Skeletons::API::BoundFunction<upperBound_func>,
+                                             YewPar::Skeletons::API::PruneLevel,
+                                             YewPar::Skeletons::API::DepthBoundedPoolPolicy<
+                                               Workstealing::Policies::WorkerDequePool> >
+            ::search(graph, root, searchParameters);
       } else {
         sol = YewPar::Skeletons::DepthBounded<GenNode,
                                              YewPar::Skeletons::API::Optimisation,
@@ -286,6 +290,7 @@ int hpx_main(hpx::program_options::variables_map & opts) {
       YewPar::Skeletons::API::Params<int> searchParameters;
       searchParameters.expectedObjective = decisionBound;
       searchParameters.stealAll = static_cast<bool>(opts.count("chunked"));
+      searchParameters.passiveSteals = static_cast<bool>(opts.count("passive"));
       sol = YewPar::Skeletons::StackStealing<GenNode,
                                              YewPar::Skeletons::API::Decision,
                                              YewPar::Skeletons::API::BoundFunction<upperBound_func>,
@@ -294,15 +299,57 @@ int hpx_main(hpx::program_options::variables_map & opts) {
     } else {
       YewPar::Skeletons::API::Params<int> searchParameters;
       searchParameters.stealAll = static_cast<bool>(opts.count("chunked"));
+      searchParameters.passiveSteals = static_cast<bool>(opts.count("passive"));
       sol = YewPar::Skeletons::StackStealing<GenNode,
                                              YewPar::Skeletons::API::Optimisation,
                                              YewPar::Skeletons::API::BoundFunction<upperBound_func>,
                                              YewPar::Skeletons::API::PruneLevel>
           ::search(graph, root, searchParameters);
     }
+  } else if (skeletonType == "indexed") {
+    if (decisionBound != 0) {
+      YewPar::Skeletons::API::Params<int> searchParameters;
+      searchParameters.expectedObjective = decisionBound;
+      searchParameters.stealAll = static_cast<bool>(opts.count("chunked"));
+      sol = YewPar::Skeletons::Indexed<GenNode,
+                                       YewPar::Skeletons::API::Decision,
+                                       YewPar::Skeletons::API::BoundFunction<upperBound_func>,
+                                       YewPar::Skeletons::API::PruneLevel>
+          ::search(graph, root, searchParameters);
+    } else {
+      YewPar::Skeletons::API::Params<int> searchParameters;
+      searchParameters.stealAll = static_cast<bool>(opts.count("chunked"));
+      sol = YewPar::Skeletons::Indexed<GenNode,
+                                       YewPar::Skeletons::API::Optimisation,
+                                       YewPar::Skeletons::API::BoundFunction<upperBound_func>,
+                                       YewPar::Skeletons::API::PruneLevel>
+          ::search(graph, root, searchParameters);
+    }
+  } else if (skeletonType == "hybrid") {
+    if (decisionBound != 0) {
+      YewPar::Skeletons::API::Params<int> searchParameters;
+      searchParameters.expectedObjective = decisionBound;
+      searchParameters.spawnDepth = spawnDepth;
+      searchParameters.stealAll = static_cast<bool>(opts.count("chunked"));
+      sol = YewPar::Skeletons::Hybrid<GenNode,
+                                      YewPar::Skeletons::API::Decision,
+                                      YewPar::Skeletons::API::BoundFunction<upperBound_func>,
+                                      YewPar::Skeletons::API::PruneLevel>
+          ::search(graph, root, searchParameters);
+    } else {
+      YewPar::Skeletons::API::Params<int> searchParameters;
+      searchParameters.spawnDepth = spawnDepth;
+      searchParameters.stealAll = static_cast<bool>(opts.count("chunked"));
+      sol = YewPar::Skeletons::Hybrid<GenNode,
+                                      YewPar::Skeletons::API::Optimisation,
+                                      YewPar::Skeletons::API::BoundFunction<upperBound_func>,
+                                      YewPar::Skeletons::API::PruneLevel>
+          ::search(graph, root, searchParameters);
+    }
   } else if (skeletonType == "ordered") {
     YewPar::Skeletons::API::Params<int> searchParameters;
     searchParameters.spawnDepth = spawnDepth;
+    searchParameters.autoSpawnDepth = static_cast<bool>(opts.count("auto-spawn-depth"));
     if (opts.count("discrepancyOrder")) {
       sol = YewPar::Skeletons::Ordered<GenNode,
                                        YewPar::Skeletons::API::Optimisation,
@@ -321,6 +368,7 @@ int hpx_main(hpx::program_options::variables_map & opts) {
     if (decisionBound != 0) {
     YewPar::Skeletons::API::Params<int> searchParameters;
     searchParameters.backtrackBudget = opts["backtrack-budget"].as<unsigned>();
+    searchParameters.adaptiveBudget = static_cast<bool>(opts.count("adaptive-budget"));
     searchParameters.expectedObjective = decisionBound;
     sol = YewPar::Skeletons::Budget<GenNode,
                                     YewPar::Skeletons::API::BoundFunction<upperBound_func>,
@@ -330,6 +378,7 @@ int hpx_main(hpx::program_options::variables_map & opts) {
     } else {
       YewPar::Skeletons::API::Params<int> searchParameters;
       searchParameters.backtrackBudget = opts["backtrack-budget"].as<unsigned>();
+      searchParameters.adaptiveBudget = static_cast<bool>(opts.count("adaptive-budget"));
       sol = YewPar::Skeletons::Budget<GenNode,
                                       YewPar::Skeletons::API::Optimisation,
                                       YewPar::Skeletons::API::BoundFunction<upperBound_func>,
@@ -337,28 +386,28 @@ int hpx_main(hpx::program_options::variables_map & opts) {
           ::search(graph, root, searchParameters);
     }
   } else {
-    hpx::cout << "Invalid skeleton type option. Should be: seq, depthbound, stacksteal or ordered" << std::endl;
-    hpx::finalize();
+    out << "Invalid skeleton type option. Should be: seq, depthbound, stacksteal, indexed, hybrid, budget or ordered" << std::endl;
     return EXIT_FAILURE;
   }
 
   auto overall_time = std::chrono::duration_cast<std::chrono::milliseconds>
     (std::chrono::steady_clock::now() - start_time);
 
-  hpx::cout << "MaxClique Size = " << sol.size << std::endl;
-  hpx::cout << "cpu = " << overall_time.count() << std::endl;
+  out << "MaxClique Size = " << sol.size << std::endl;
+  out << "cpu = " << overall_time.count() << std::endl;
 
-  return hpx::finalize();
+  return EXIT_SUCCESS;
 }
 
-int main (int argc, char* argv[]) {
+// Options for a single search, also used to parse jobs when serving
+hpx::program_options::options_description searchOptions() {
   hpx::program_options::options_description
     desc_commandline("Usage: " HPX_APPLICATION_STRING " [options]");
 
   desc_commandline.add_options()
     ( "skeleton",
       hpx::program_options::value<std::string>()->default_value("seq"),
-      "Which skeleton to use: seq, depthbound, stacksteal, budget, or ordered"
+      "Which skeleton to use: seq, depthbound, stacksteal, indexed, hybrid, budget, or ordered"
       )
     ( "spawn-depth,d",
       hpx::program_options::value<std::uint64_t>()->default_value(0),
@@ -369,19 +418,67 @@ int main (int argc, char* argv[]) {
       "Number of backtracks before spawning work"
       )
     ( "input-file,f",
-      hpx::program_options::value<std::string>()->required(),
+      hpx::program_options::value<std::string>(),
       "DIMACS formatted input graph"
       )
+    ( "batch",
+      hpx::program_options::value<std::string>(),
+      "Solve every DIMACS graph in a directory, or listed in a file (one per line), in one run"
+      )
+    ( "serve",
+      hpx::program_options::value<std::string>(),
+      "Serve search jobs on this Unix domain socket until asked to shut down"
+      )
     ("discrepancyOrder", "Use discrepancy order for the ordered skeleton")
-    ("chunked", "Use chunking with stack stealing")
+    ("chunked", "Use chunking with stack stealing, indexed or hybrid")
+    ("passive", "Let thieves take work straight off stacks with stack stealing")
+    ("auto-spawn-depth", "Choose the spawn depth automatically (depthbounded and ordered)")
+    ("adaptive-budget", "Tune the backtrack budget at runtime, starting from -b (budget)")
     ("poolType",
      hpx::program_options::value<std::string>()->default_value("depthpool"),
-     "Pool type for depthbounded skeleton")
+     "Pool type for depthbounded skeleton: depthpool, deque or workerdeques")
     ( "decisionBound",
     hpx::program_options::value<int>()->default_value(0),
     "For Decision Skeletons. Size of the clique to search for"
     );
 
+  return desc_commandline;
+}
+
+int hpx_main(hpx::program_options::variables_map & opts) {
+  int res;
+  if (opts.count("serve")) {
+    res = YewPar::Service::serve(opts["serve"].as<std::string>(), searchOptions(),
+                                 [](hpx::program_options::variables_map & job, std::ostream & out) {
+      if (!job.count("input-file")) {
+        out << "Expected a DIMACS input file (--input-file)" << std::endl;
+        return EXIT_FAILURE;
+      }
+      return solve(job, job["input-file"].as<std::string>(), out);
+    });
+  } else if (opts.count("batch")) {
+    auto instances = YewPar::Batch::findInstances(opts["batch"].as<std::string>());
+    res = YewPar::Batch::run(instances, [&](const YewPar::Batch::Instance & inst) {
+      if (inst.size() != 1) {
+        hpx::cout << "Expected one DIMACS file per instance" << std::endl;
+        return EXIT_FAILURE;
+      }
+      return solve(opts, inst[0], hpx::cout);
+    });
+  } else if (opts.count("input-file")) {
+    res = solve(opts, opts["input-file"].as<std::string>(), hpx::cout);
+  } else {
+    std::cerr << "You must provide a DIMACS input file (--input-file) or a batch (--batch)" << std::endl;
+    res = EXIT_FAILURE;
+  }
+
+  hpx::finalize();
+  return res;
+}
+
+int main (int argc, char* argv[]) {
+  auto desc_commandline = searchOptions();
+
   YewPar::registerPerformanceCounters();
 
   hpx::init_params args;
@@ -19,6 +19,9 @@
 #include "skeletons/DepthBounded.hpp"
 //#include "skeletons/StackStealing.hpp"
 
+#include "util/Batch.hpp"
+#include "util/Service.hpp"
+
 // Number of Words to use in our bitset representation
 // Possible to specify at compile to to handler bigger graphs if required
 #ifndef NWORDS
@@ -217,10 +220,11 @@ typedef func<decltype(&upperBound), &upperBound> upperBound_func;
 // using cfunc  = ss_skel::SubTreeTask;
 // REGISTER_SEARCHMANAGER(MCNode, cfunc);
 
-int hpx_main(hpx::program_options::variables_map & opts) {
-  auto patternF = opts["pattern-file"].as<std::string>();
-  auto targetF  = opts["target-file"].as<std::string>();
-
+// Solve a single instance and print the result to out
+int solve(hpx::program_options::variables_map & opts,
+          const std::string & patternF,
+          const std::string & targetF,
+          std::ostream & out) {
   auto patternG = read_vf(patternF, opts.count("unlabelled"), opts.count("no-edge-labels"), opts.count("undirected"));
   auto targetG = read_vf(targetF, opts.count("unlabelled"), opts.count("no-edge-labels"), opts.count("undirected"));
 
@@ -230,8 +234,7 @@ int hpx_main(hpx::program_options::variables_map & opts) {
   std::tie(graph, order, invorder) = buildGraph<NWORDS>(prod);
 
   if (graph.size() > bits_per_word*NWORDS) {
-    std::cout << "Binary Cannot Handle Graph of this size. Recompile with a bigger NWORDS" << std::endl;
-    hpx::finalize();
+    out << "Binary Cannot Handle Graph of this size. Recompile with a bigger NWORDS" << std::endl;
     return EXIT_FAILURE;
   }
 
@@ -266,20 +269,19 @@ int hpx_main(hpx::program_options::variables_map & opts) {
   }
 
   // Print Results
-  std::cout << std::boolalpha << ! isomorphism.empty() << " " << 0;
-  std::cout << " " << isomorphism.size() << std::endl;
+  out << std::boolalpha << ! isomorphism.empty() << " " << 0;
+  out << " " << isomorphism.size() << std::endl;
 
   for (auto v : isomorphism)
-      std::cout << "(" << v.first << " -> " << v.second << ") ";
-  std::cout << std::endl;
+      out << "(" << v.first << " -> " << v.second << ") ";
+  out << std::endl;
 
-  std::cout << overall_time.count() << std::endl;
+  out << overall_time.count() << std::endl;
 
   auto graphs = std::make_pair(patternG, targetG);
   for (auto & p : isomorphism) {
       if (graphs.first.vertex_labels.at(p.first) != graphs.second.vertex_labels.at(p.second)) {
           std::cerr << "Oops! not an isomorphism due to vertex labels" << std::endl;
-          hpx::finalize();
           return EXIT_FAILURE;
       }
   }
@@ -291,16 +293,16 @@ int hpx_main(hpx::program_options::variables_map & opts) {
                   << std::to_string(q.first) << " (" << graphs.first.edges[p.first][q.first] << ") vs "
                   << std::to_string(p.second) << "--" << std::to_string(q.second) << " ("
                   << graphs.second.edges[p.second][q.second] << ")" << std::endl;
-              hpx::finalize();
               return EXIT_FAILURE;
           }
       }
   }
 
-  return hpx::finalize();
+  return EXIT_SUCCESS;
 }
 
-int main (int argc, char* argv[]) {
+// Options for a single search, also used to parse jobs when serving
+hpx::program_options::options_description searchOptions() {
   hpx::program_options::options_description
     desc_commandline("Usage: " HPX_APPLICATION_STRING " [options]");
 
@@ -317,10 +319,55 @@ int main (int argc, char* argv[]) {
       hpx::program_options::value<std::string>(),
       "VF formatted input graph"
     )
+    ( "batch",
+      hpx::program_options::value<std::string>(),
+      "Solve every pattern and target pair listed in a file (one pair per line) in one run"
+    )
+    ( "serve",
+      hpx::program_options::value<std::string>(),
+      "Serve search jobs on this Unix domain socket until asked to shut down"
+    )
     ("unlabelled", "Make the graph unlabelled")
     ("no-edge-labels", "Get rid of edge labels, but keep vertex labels")
     ("undirected", "Make the graph undirected");
 
+  return desc_commandline;
+}
+
+int hpx_main(hpx::program_options::variables_map & opts) {
+  int res;
+  if (opts.count("serve")) {
+    res = YewPar::Service::serve(opts["serve"].as<std::string>(), searchOptions(),
+                                 [](hpx::program_options::variables_map & job, std::ostream & out) {
+      if (!(job.count("pattern-file") && job.count("target-file"))) {
+        out << "Expected pattern and target files (--pattern-file, --target-file)" << std::endl;
+        return EXIT_FAILURE;
+      }
+      return solve(job, job["pattern-file"].as<std::string>(), job["target-file"].as<std::string>(), out);
+    });
+  } else if (opts.count("batch")) {
+    auto instances = YewPar::Batch::findInstances(opts["batch"].as<std::string>());
+    res = YewPar::Batch::run(instances, [&](const YewPar::Batch::Instance & inst) {
+      if (inst.size() != 2) {
+        std::cout << "Expected a pattern and a target file per instance" << std::endl;
+        return EXIT_FAILURE;
+      }
+      return solve(opts, inst[0], inst[1], hpx::cout);
+    });
+  } else if (opts.count("pattern-file") && opts.count("target-file")) {
+    res = solve(opts, opts["pattern-file"].as<std::string>(), opts["target-file"].as<std::string>(), hpx::cout);
+  } else {
+    std::cerr << "You must provide pattern and target files or a batch (--batch)" << std::endl;
+    res = EXIT_FAILURE;
+  }
+
+  hpx::finalize();
+  return res;
+}
+
+int main (int argc, char* argv[]) {
+  auto desc_commandline = searchOptions();
+
   hpx::init_params args;
   args.desc_cmdline = desc_commandline;
   return hpx::init(argc, argv, args);
@@ -9,12 +9,15 @@
 
 #include "parser.hpp"
 #include "YewPar.hpp"
+#include "util/Batch.hpp"
+#include "util/Service.hpp"
 
 #include "skeletons/Seq.hpp"
 #include "skeletons/DepthBounded.hpp"
 #include "skeletons/Ordered.hpp"
 #include "skeletons/Budget.hpp"
 #include "skeletons/StackStealing.hpp"
+#include "skeletons/BestFirst.hpp"
 
 #define MAX_CITIES  64
 
@@ -203,15 +206,15 @@ unsigned calculateTourLength(const DistanceMatrix<MAX_CITIES> & distances,
   return l;
 }
 
-int hpx_main(hpx::program_options::variables_map & opts) {
-  auto inputFile = opts["input-file"].as<std::string>();
-
+// Solve a single instance and print the result to out
+int solve(hpx::program_options::variables_map & opts, const std::string & inputFile,
+          std::ostream & out) {
   TSPFromFile inputData;
   try {
     inputData = parseFile(inputFile);
   } catch (SomethingWentWrong & e) {
     std::cerr << e.what() << std::endl;
-    hpx::finalize();
+    return EXIT_FAILURE;
   }
 
   DistanceMatrix<MAX_CITIES> distances;
@@ -288,39 +291,54 @@ int hpx_main(hpx::program_options::variables_map & opts) {
                                            YewPar::Skeletons::API::BoundFunction<upperBound_func>,
                                            YewPar::Skeletons::API::ObjectiveComparison<std::less<unsigned>>>
         ::search(space, root, searchParameters);
+  } else if (skeletonType == "bestfirst") {
+    sol = YewPar::Skeletons::BestFirst<NodeGen,
+                                       YewPar::Skeletons::API::Optimisation,
+                                       YewPar::Skeletons::API::BoundFunction<upperBound_func>,
+                                       YewPar::Skeletons::API::ObjectiveComparison<std::less<unsigned>>>
+        ::search(space, root, searchParameters);
   } else {
-    hpx::cout << "Invalid skeleton type\n";
-    return hpx::finalize();
+    out << "Invalid skeleton type\n";
+    return EXIT_FAILURE;
   }
 
   auto overall_time = std::chrono::duration_cast<std::chrono::milliseconds>
                       (std::chrono::steady_clock::now() - start_time);
 
-  hpx::cout << "Tour: ";
+  out << "Tour: ";
   for (const auto c : sol.sol.cities) {
-    hpx::cout << c << ",";
+    out << c << ",";
   }
-  hpx::cout << std::endl;
-  hpx::cout << "Optimal tour length: " << sol.sol.tourLength << "\n";
+  out << std::endl;
+  out << "Optimal tour length: " << sol.sol.tourLength << "\n";
 
-  hpx::cout << "cpu = " << overall_time.count() << std::endl;
+  out << "cpu = " << overall_time.count() << std::endl;
 
-  return hpx::finalize();
+  return EXIT_SUCCESS;
 }
 
-int main(int argc, char* argv[]) {
+// Options for a single search, also used to parse jobs when serving
+hpx::program_options::options_description searchOptions() {
   hpx::program_options::options_description
       desc_commandline("Usage: " HPX_APPLICATION_STRING " [options]");
 
   desc_commandline.add_options()
       ( "skeleton",
         hpx::program_options::value<std::string>()->default_value("seq"),
-        "Which skeleton to use: seq, depthbound, stacksteal, budget, or ordered"
+        "Which skeleton to use: seq, depthbound, stacksteal, budget, ordered, or bestfirst"
         )
       ( "input-file,f",
-        hpx::program_options::value<std::string>()->required(),
+        hpx::program_options::value<std::string>(),
         "Input problem"
         )
+      ( "batch",
+        hpx::program_options::value<std::string>(),
+        "Solve every problem in a directory, or listed in a file (one per line), in one run"
+        )
+      ( "serve",
+        hpx::program_options::value<std::string>(),
+        "Serve search jobs on this Unix domain socket until asked to shut down"
+        )
       ( "backtrack-budget,b",
         hpx::program_options::value<unsigned>()->default_value(500),
         "Number of backtracks before spawning work"
@@ -332,6 +350,43 @@ int main(int argc, char* argv[]) {
         "Depth in the tree to spawn until (for parallel skeletons only)"
         );
 
+  return desc_commandline;
+}
+
+int hpx_main(hpx::program_options::variables_map & opts) {
+  int res;
+  if (opts.count("serve")) {
+    res = YewPar::Service::serve(opts["serve"].as<std::string>(), searchOptions(),
+                                 [](hpx::program_options::variables_map & job, std::ostream & out) {
+      if (!job.count("input-file")) {
+        out << "Expected an input problem (--input-file)" << std::endl;
+        return EXIT_FAILURE;
+      }
+      return solve(job, job["input-file"].as<std::string>(), out);
+    });
+  } else if (opts.count("batch")) {
+    auto instances = YewPar::Batch::findInstances(opts["batch"].as<std::string>());
+    res = YewPar::Batch::run(instances, [&](const YewPar::Batch::Instance & inst) {
+      if (inst.size() != 1) {
+        hpx::cout << "Expected one TSPLIB file per instance" << std::endl;
+        return EXIT_FAILURE;
+      }
+      return solve(opts, inst[0], hpx::cout);
+    });
+  } else if (opts.count("input-file")) {
+    res = solve(opts, opts["input-file"].as<std::string>(), hpx::cout);
+  } else {
+    std::cerr << "You must provide an input problem (--input-file) or a batch (--batch)" << std::endl;
+    res = EXIT_FAILURE;
+  }
+
+  hpx::finalize();
+  return res;
+}
+
+int main(int argc, char* argv[]) {
+  auto desc_commandline = searchOptions();
+
   YewPar::registerPerformanceCounters();
 
   hpx::init_params args;
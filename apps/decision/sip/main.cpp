@@ -19,7 +19,10 @@
 #include "skeletons/StackStealing.hpp"
 #include "skeletons/Ordered.hpp"
 #include "skeletons/Budget.hpp"
+#include "skeletons/Indexed.hpp"
 
+#include "util/Batch.hpp"
+#include "util/Service.hpp"
 #include "util/func.hpp"
 #include "util/NodeGenerator.hpp"
 
@@ -636,17 +639,27 @@ struct GenNode : YewPar::NodeGenerator<SIPNode<n_words_>, Model<n_words_>> {
     //return SIPNode<n_words_>(std::move(new_domains), std::move(newAssignments), prop);
     return SIPNode<n_words_>(new_domains, std::move(newAssignments), prop);
   }
+
+  // Jump straight to the nth value without propagating the ones before it
+  SIPNode<n_words_> nth(unsigned n) {
+    if (!sat) { f_v = n; }
+    return next();
+  }
 };
 
-int hpx_main(hpx::program_options::variables_map & opts) {
-  hpx::cout << "Using pattern file: " << opts["pattern"].as<std::string>() << std::endl;
-  hpx::cout << "Using target file: " << opts["target"].as<std::string>() << std::endl;
-  auto patternG = read_lad(opts["pattern"].as<std::string>());
-  auto targetG  = read_lad(opts["target"].as<std::string>());
+// Solve a single instance and print the result to out
+int solve(hpx::program_options::variables_map & opts,
+          const std::string & patternFile,
+          const std::string & targetFile,
+          std::ostream & out) {
+  out << "Using pattern file: " << patternFile << std::endl;
+  out << "Using target file: " << targetFile << std::endl;
+  auto patternG = read_lad(patternFile);
+  auto targetG  = read_lad(targetFile);
 
   if (patternG.size() > targetG.size()) {
     std::cerr << "Pattern graph larger than Target graph\n";
-    return hpx::finalize();
+    return EXIT_SUCCESS;
   }
 
   const Model<NWORDS> m(targetG, patternG);
@@ -654,7 +667,7 @@ int hpx_main(hpx::program_options::variables_map & opts) {
   Domains<NWORDS> domains(m.pattern_size);
   if (!initialise_domains(m, domains)) {
     std::cerr << "Could not initialise domains\n";
-    return hpx::finalize();
+    return EXIT_SUCCESS;
   }
 
   Assignments assignments;
@@ -699,6 +712,12 @@ int hpx_main(hpx::program_options::variables_map & opts) {
                                          YewPar::Skeletons::API::Decision,
                                          YewPar::Skeletons::API::MoreVerbose>
         ::search(m, root, searchParameters);
+  } else if (skeleton ==  "indexed") {
+    searchParameters.stealAll = static_cast<bool>(opts.count("chunked"));
+    sol = YewPar::Skeletons::Indexed<GenNode<NWORDS>,
+                                     YewPar::Skeletons::API::Decision,
+                                     YewPar::Skeletons::API::MoreVerbose>
+        ::search(m, root, searchParameters);
   } else if (skeleton ==  "budget") {
     searchParameters.backtrackBudget = opts["backtrack-budget"].as<std::uint64_t>();
     sol = YewPar::Skeletons::Budget<GenNode<NWORDS>,
@@ -722,7 +741,7 @@ int hpx_main(hpx::program_options::variables_map & opts) {
     }
   } else {
     std::cerr << "Invalid skeleton type\n";
-    return hpx::finalize();
+    return EXIT_FAILURE;
   }
 
   std::map<int, int> res_isomorphism;
@@ -734,27 +753,28 @@ int hpx_main(hpx::program_options::variables_map & opts) {
   auto overall_time = std::chrono::duration_cast<std::chrono::milliseconds>
       (std::chrono::steady_clock::now() - start_time);
 
-  hpx::cout << "Solution found: " << std::boolalpha << !res_isomorphism.empty() << std::endl;
+  out << "Solution found: " << std::boolalpha << !res_isomorphism.empty() << std::endl;
   if (!res_isomorphism.empty()) {
-    hpx::cout << "mapping = ";
+    out << "mapping = ";
     for (auto v : res_isomorphism)
-      hpx::cout << "(" << v.first << " -> " << v.second << ") ";
-    hpx::cout << std::endl;
+      out << "(" << v.first << " -> " << v.second << ") ";
+    out << std::endl;
   }
 
-  hpx::cout << "cpu = " << overall_time.count() << std::endl;
+  out << "cpu = " << overall_time.count() << std::endl;
 
-  return hpx::finalize();
+  return EXIT_SUCCESS;
 }
 
-int main (int argc, char* argv[]) {
+// Options for a single search, also used to parse jobs when serving
+hpx::program_options::options_description searchOptions() {
   hpx::program_options::options_description
       desc_commandline("Usage: " HPX_APPLICATION_STRING " [options]");
 
   desc_commandline.add_options()
       ( "skeleton",
         hpx::program_options::value<std::string>()->default_value("seq"),
-        "Which skeleton to use: seq, depthbound, stacksteal, budget, or ordered"
+        "Which skeleton to use: seq, depthbound, stacksteal, indexed, budget, or ordered"
       )
       ( "spawn-depth,d",
         hpx::program_options::value<std::uint64_t>()->default_value(0),
@@ -768,16 +788,61 @@ int main (int argc, char* argv[]) {
        hpx::program_options::value<std::string>()->default_value("depthpool"),
        "Pool type for depthbounded skeleton")
       ("discrepancyOrder", "Use discrepancy order for the ordered skeleton")
-      ("chunked", "Use chunking with stack stealing")
+      ("chunked", "Use chunking with stack stealing or indexed")
       ("pattern",
-      hpx::program_options::value<std::string>()->required(),
+      hpx::program_options::value<std::string>(),
       "Specify the pattern file (LAD format)"
       )
       ("target",
-      hpx::program_options::value<std::string>()->required(),
+      hpx::program_options::value<std::string>(),
       "Specify the target file (LAD format)"
+      )
+      ("batch",
+      hpx::program_options::value<std::string>(),
+      "Solve every pattern and target pair listed in a file (one pair per line) in one run"
+      )
+      ("serve",
+      hpx::program_options::value<std::string>(),
+      "Serve search jobs on this Unix domain socket until asked to shut down"
       );
 
+  return desc_commandline;
+}
+
+int hpx_main(hpx::program_options::variables_map & opts) {
+  int res;
+  if (opts.count("serve")) {
+    res = YewPar::Service::serve(opts["serve"].as<std::string>(), searchOptions(),
+                                 [](hpx::program_options::variables_map & job, std::ostream & out) {
+      if (!(job.count("pattern") && job.count("target"))) {
+        out << "Expected pattern and target files (--pattern, --target)" << std::endl;
+        return EXIT_FAILURE;
+      }
+      return solve(job, job["pattern"].as<std::string>(), job["target"].as<std::string>(), out);
+    });
+  } else if (opts.count("batch")) {
+    auto instances = YewPar::Batch::findInstances(opts["batch"].as<std::string>());
+    res = YewPar::Batch::run(instances, [&](const YewPar::Batch::Instance & inst) {
+      if (inst.size() != 2) {
+        std::cerr << "Expected a pattern and a target file per instance\n";
+        return EXIT_FAILURE;
+      }
+      return solve(opts, inst[0], inst[1], hpx::cout);
+    });
+  } else if (opts.count("pattern") && opts.count("target")) {
+    res = solve(opts, opts["pattern"].as<std::string>(), opts["target"].as<std::string>(), hpx::cout);
+  } else {
+    std::cerr << "You must provide pattern and target files or a batch (--batch)\n";
+    res = EXIT_FAILURE;
+  }
+
+  hpx::finalize();
+  return res;
+}
+
+int main (int argc, char* argv[]) {
+  auto desc_commandline = searchOptions();
+
   YewPar::registerPerformanceCounters();
 
   hpx::init_params args;
@@ -7,12 +7,17 @@
 
 #include <vector>
 #include <chrono>
+#include <cstdlib>
+#include <string>
 
 #include "YewPar.hpp"
 #include "skeletons/Seq.hpp"
 #include "skeletons/DepthBounded.hpp"
 #include "skeletons/StackStealing.hpp"
 #include "skeletons/Budget.hpp"
+#include "skeletons/Ordered.hpp"
+
+#include "util/Batch.hpp"
 
 #include "monoid.hpp"
 
@@ -57,9 +62,9 @@ struct CountDepths : YewPar::Enumerator<Monoid, std::vector<uint64_t>> {
 };
 
 
-int hpx_main(hpx::program_options::variables_map & opts) {
+// Count the semigroups up to genus maxDepth and print the results
+int solve(hpx::program_options::variables_map & opts, unsigned maxDepth) {
   auto spawnDepth = opts["spawn-depth"].as<unsigned>();
-  auto maxDepth   = opts["genus"].as<unsigned>();
   auto skeleton   = opts["skeleton"].as<std::string>();
   //auto stealAll   = opts["stealall"].as<bool>();
 
@@ -104,9 +109,18 @@ int hpx_main(hpx::program_options::variables_map & opts) {
                                        YewPar::Skeletons::API::Enumerator<CountDepths>,
                                        YewPar::Skeletons::API::DepthLimited>
         ::search(Empty(), root, searchParameters);
+  } else if (skeleton == "ordered"){
+    YewPar::Skeletons::API::Params<> searchParameters;
+    searchParameters.maxDepth   = maxDepth;
+    searchParameters.spawnDepth = spawnDepth;
+    counts = YewPar::Skeletons::Ordered<NodeGen,
+                                        YewPar::Skeletons::API::Enumeration,
+                                        YewPar::Skeletons::API::Enumerator<CountDepths>,
+                                        YewPar::Skeletons::API::DepthLimited>
+        ::search(Empty(), root, searchParameters);
   } else {
     hpx::cout << "Invalid skeleton type: " << skeleton << std::endl;
-    return hpx::finalize();
+    return EXIT_FAILURE;
   }
 
   auto overall_time = std::chrono::duration_cast<std::chrono::milliseconds>
@@ -119,7 +133,26 @@ int hpx_main(hpx::program_options::variables_map & opts) {
   hpx::cout << "=====" << std::endl;
   hpx::cout << "cpu = " << overall_time.count() << std::endl;
 
-  return hpx::finalize();
+  return EXIT_SUCCESS;
+}
+
+int hpx_main(hpx::program_options::variables_map & opts) {
+  int res;
+  if (opts.count("batch-genus")) {
+    // Each instance is just a genus, there are no input files
+    std::vector<YewPar::Batch::Instance> instances;
+    for (auto g : opts["batch-genus"].as<std::vector<unsigned> >()) {
+      instances.push_back({std::to_string(g)});
+    }
+    res = YewPar::Batch::run(instances, [&](const YewPar::Batch::Instance & inst) {
+      return solve(opts, std::stoul(inst[0]));
+    });
+  } else {
+    res = solve(opts, opts["genus"].as<unsigned>());
+  }
+
+  hpx::finalize();
+  return res;
 }
 
 int main(int argc, char* argv[]) {
@@ -129,7 +162,7 @@ int main(int argc, char* argv[]) {
   desc_commandline.add_options()
     ( "skeleton",
       hpx::program_options::value<std::string>()->default_value("seq"),
-      "Which skeleton to use: seq, depthbound, stacksteal, or budget"
+      "Which skeleton to use: seq, depthbound, stacksteal, budget, or ordered"
     )
     ( "spawn-depth,d",
       hpx::program_options::value<unsigned>()->default_value(0),
@@ -139,6 +172,10 @@ int main(int argc, char* argv[]) {
       hpx::program_options::value<unsigned>()->default_value(0),
       "Depth in the tree to count until"
     )
+    ( "batch-genus",
+      hpx::program_options::value<std::vector<unsigned> >()->multitoken(),
+      "Count up to each of these genera in turn, in one run"
+    )
     ( "backtrack-budget,b",
       hpx::program_options::value<unsigned>()->default_value(500),
       "Number of backtracks before spawning work"
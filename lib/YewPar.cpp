@@ -1,5 +1,6 @@
 #include "workstealing/policies/SearchManager.hpp"
 #include "workstealing/policies/Workpool.hpp"
+#include "workstealing/policies/WorkerDequePool.hpp"
 #include "workstealing/policies/PriorityOrdered.hpp"
 #include "workstealing/policies/DepthPoolPolicy.hpp"
 
@@ -8,6 +9,7 @@ namespace YewPar {
 void registerPerformanceCounters() {
   hpx::register_startup_function(&Workstealing::Policies::SearchManagerPerf::registerPerformanceCounters);
   hpx::register_startup_function(&Workstealing::Policies::WorkpoolPerf::registerPerformanceCounters);
+  hpx::register_startup_function(&Workstealing::Policies::WorkerDequePoolPerf::registerPerformanceCounters);
   hpx::register_startup_function(&Workstealing::Policies::PriorityOrderedPerf::registerPerformanceCounters);
   hpx::register_startup_function(&Workstealing::Policies::DepthPoolPolicyPerf::registerPerformanceCounters);
 }
@@ -82,13 +82,26 @@ struct Params {
   // Depth Spawns
   unsigned spawnDepth = 1;
 
+  // Let DepthBounded/Ordered pick spawnDepth by sampling the tree, aiming for
+  // tasksPerWorker tasks per worker thread. spawnDepth is ignored when set.
+  bool autoSpawnDepth = false;
+  unsigned tasksPerWorker = 16;
+
   // Stack Steals
   // Should we steal all remaining nodes at the highest depth or just one?
   bool stealAll = false;
 
+  // Let thieves claim nodes directly from a running stack rather than asking
+  // its owner. Requires deterministic generators.
+  bool passiveSteals = false;
+
   // Budget
   unsigned backtrackBudget = 100000;
 
+  // Grow/shrink backtrackBudget at runtime based on the work pool counters.
+  // backtrackBudget is then only the starting value.
+  bool adaptiveBudget = false;
+
   // Needed to push to registries on all nodes
   template <class Archive>
   void serialize(Archive & ar, const unsigned int version) {
@@ -96,8 +109,12 @@ struct Params {
     ar & expectedObjective;
     ar & initialBound;
     ar & spawnDepth;
+    ar & autoSpawnDepth;
+    ar & tasksPerWorker;
     ar & stealAll;
+    ar & passiveSteals;
     ar & backtrackBudget;
+    ar & adaptiveBudget;
   }
 
   std::string toString() const {
@@ -106,8 +123,12 @@ struct Params {
     ss << "expectedObjective" << expectedObjective << std::endl;
     ss << "initialBound" << initialBound << std::endl;
     ss << "spawnDepth" << spawnDepth << std::endl;
+    ss << "autoSpawnDepth" << autoSpawnDepth << std::endl;
+    ss << "tasksPerWorker" << tasksPerWorker << std::endl;
     ss << "stealAll" << stealAll << std::endl;
+    ss << "passiveSteals" << passiveSteals << std::endl;
     ss << "backtrack Budget" << backtrackBudget << std::endl;
+    ss << "adaptive Budget" << adaptiveBudget << std::endl;
     return ss.str();
   }
 };
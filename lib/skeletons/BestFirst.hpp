@@ -0,0 +1,446 @@
+#ifndef SKELETONS_BESTFIRST_HPP
+#define SKELETONS_BESTFIRST_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include "API.hpp"
+
+#include <hpx/collectives/broadcast.hpp>
+#include <hpx/execution.hpp>
+#include <hpx/iostream.hpp>
+#include <hpx/serialization/vector.hpp>
+#include <hpx/synchronization/mutex.hpp>
+
+#include "util/NodeGenerator.hpp"
+#include "util/Registry.hpp"
+#include "util/Incumbent.hpp"
+#include "util/func.hpp"
+#include "util/util.hpp"
+
+#include "Common.hpp"
+
+namespace YewPar { namespace Skeletons {
+
+// Best-first branch and bound. Open nodes are kept in a frontier ordered by
+// their bound rather than being explored depth first. Each worker owns a heap
+// and periodically exchanges its best nodes with a locality wide frontier, so
+// the whole locality approximately explores the most promising nodes first.
+// Idle localities steal the best nodes from the frontiers of other localities.
+//
+// There is no limit on the size of the frontier so problems with very weak
+// bounds can use a lot of memory.
+template <typename Generator, typename ...Args>
+struct BestFirst {
+  typedef typename Generator::Nodetype Node;
+  typedef typename Generator::Spacetype Space;
+
+  typedef typename API::skeleton_signature::bind<Args...>::type args;
+
+  static constexpr bool isEnumeration = parameter::value_type<args, API::tag::Enumeration_, std::integral_constant<bool, false> >::type::value;
+  static constexpr bool isOptimisation = parameter::value_type<args, API::tag::Optimisation_, std::integral_constant<bool, false> >::type::value;
+  static constexpr bool isDecision = parameter::value_type<args, API::tag::Decision_, std::integral_constant<bool, false> >::type::value;
+  static constexpr bool isDepthLimited = parameter::value_type<args, API::tag::DepthLimited_, std::integral_constant<bool, false> >::type::value;
+  static constexpr bool pruneLevel = parameter::value_type<args, API::tag::PruneLevel_, std::integral_constant<bool, false> >::type::value;
+
+  typedef typename parameter::value_type<args, API::tag::Verbose_, std::integral_constant<unsigned, 0> >::type Verbose;
+  static constexpr unsigned verbose = Verbose::value;
+
+  typedef typename parameter::value_type<args, API::tag::BoundFunction, nullFn__>::type boundFn;
+  typedef typename boundFn::return_type Bound;
+  typedef typename parameter::value_type<args, API::tag::ObjectiveComparison, std::greater<Bound> >::type Objcmp;
+  typedef typename parameter::value_type<args, API::tag::Enumerator, IdentityEnumerator<Node>>::type Enum;
+
+  // Number of node expansions between exchanges with the locality frontier
+  static constexpr unsigned exchangeInterval = 16;
+
+  // Max number of nodes moved in a single exchange/steal
+  static constexpr unsigned exchangeSize = 8;
+
+  // Time between termination checks on the root locality
+  static constexpr std::chrono::microseconds terminationPoll{1000};
+
+  static void printSkeletonDetails() {
+    hpx::cout << "Skeleton Type: BestFirst\n";
+    hpx::cout << "Optimisation: " << std::boolalpha << isOptimisation << "\n";
+    hpx::cout << "Decision: " << std::boolalpha << isDecision << "\n";
+    hpx::cout << "DepthLimited: " << std::boolalpha << isDepthLimited << "\n";
+    hpx::cout << "PruneLevel Optimisation: " << std::boolalpha << pruneLevel << "\n";
+    hpx::cout << std::flush;
+  }
+
+  struct OpenNode {
+    Bound bnd;
+    unsigned depth;
+    Node node;
+
+    template <class Archive>
+    void serialize(Archive & ar, const unsigned int version) {
+      ar & bnd;
+      ar & depth;
+      ar & node;
+    }
+  };
+
+  // Heap order, best bound on top
+  struct OpenNodeCmp {
+    bool operator()(const OpenNode & a, const OpenNode & b) const {
+      Objcmp cmp;
+      return cmp(b.bnd, a.bnd);
+    }
+  };
+
+  // std::priority_queue doesn't let us move out of top() so we manage the heap directly
+  struct Heap {
+    std::vector<OpenNode> nodes;
+
+    bool empty() const { return nodes.empty(); }
+    std::size_t size() const { return nodes.size(); }
+    const OpenNode & top() const { return nodes.front(); }
+    void clear() { nodes.clear(); }
+
+    void push(OpenNode n) {
+      nodes.push_back(std::move(n));
+      std::push_heap(nodes.begin(), nodes.end(), OpenNodeCmp());
+    }
+
+    OpenNode pop() {
+      std::pop_heap(nodes.begin(), nodes.end(), OpenNodeCmp());
+      auto n = std::move(nodes.back());
+      nodes.pop_back();
+      return n;
+    }
+  };
+
+  // Locality wide frontier and idle tracking (for termination), one per
+  // search context
+  struct Frontier {
+    using MutexT = hpx::mutex;
+    MutexT mtx;
+
+    // Context currently using the frontier, steals for any other are refused
+    Context::Id ctx = 0;
+
+    Heap heap;
+
+    unsigned numWorkers = 0;
+    unsigned idleWorkers = 0;
+
+    // Incremented every time a worker goes from idle to active
+    std::uint64_t epoch = 0;
+
+    // Only one remote steal at a time per locality
+    bool isStealingDistributed = false;
+
+    std::atomic<bool> done {false};
+
+    std::vector<hpx::id_type> remotes;
+    std::mt19937 randGenerator;
+  };
+
+  static Frontier * getFrontier(Context::Id ctx = Context::current()) {
+    static Context::PerContext<Frontier> frontiers;
+    return &frontiers.get(ctx);
+  }
+
+  // Frontiers are reused by later contexts in the same slot so everything is
+  // reset here
+  static void initFrontier(Context::Id ctx) {
+    auto frontier = getFrontier(ctx);
+    std::lock_guard<typename Frontier::MutexT> l(frontier->mtx);
+    frontier->ctx = ctx;
+    frontier->heap.clear();
+    frontier->numWorkers = util::getNumWorkers();
+    frontier->idleWorkers = 0;
+    frontier->epoch = 0;
+    frontier->isStealingDistributed = false;
+    frontier->done.store(false);
+    frontier->remotes = util::findOtherLocalities();
+    std::random_device rd;
+    frontier->randGenerator.seed(rd());
+  }
+  struct InitFrontierAct : hpx::actions::make_action<
+    decltype(&BestFirst<Generator, Args...>::initFrontier),
+    &BestFirst<Generator, Args...>::initFrontier,
+    InitFrontierAct>::type {};
+
+  static void pushRoot(const Node root, const Bound bnd) {
+    auto frontier = getFrontier();
+    std::lock_guard<typename Frontier::MutexT> l(frontier->mtx);
+    frontier->heap.push(OpenNode{bnd, 1, root});
+  }
+
+  // Give away up to n of the best nodes in our frontier
+  static std::vector<OpenNode> stealNodes(Context::Id ctx, unsigned n) {
+    auto frontier = getFrontier(ctx);
+    std::vector<OpenNode> res;
+    std::lock_guard<typename Frontier::MutexT> l(frontier->mtx);
+    if (frontier->ctx != ctx) {
+      return res;
+    }
+    while (!frontier->heap.empty() && res.size() < n) {
+      res.push_back(frontier->heap.pop());
+    }
+    return res;
+  }
+  struct StealNodesAct : hpx::actions::make_action<
+    decltype(&BestFirst<Generator, Args...>::stealNodes),
+    &BestFirst<Generator, Args...>::stealNodes,
+    StealNodesAct>::type {};
+
+  // Returns the activity epoch if every worker is idle and the frontier is
+  // empty, -1 otherwise
+  static std::int64_t getIdleEpoch(Context::Id ctx) {
+    auto frontier = getFrontier(ctx);
+    std::lock_guard<typename Frontier::MutexT> l(frontier->mtx);
+    if (frontier->idleWorkers == frontier->numWorkers && frontier->heap.empty()) {
+      return static_cast<std::int64_t>(frontier->epoch);
+    }
+    return -1;
+  }
+  struct GetIdleEpochAct : hpx::actions::make_action<
+    decltype(&BestFirst<Generator, Args...>::getIdleEpoch),
+    &BestFirst<Generator, Args...>::getIdleEpoch,
+    GetIdleEpochAct>::type {};
+
+  static void setDone(Context::Id ctx) {
+    getFrontier(ctx)->done.store(true);
+  }
+  struct SetDoneAct : hpx::actions::make_action<
+    decltype(&BestFirst<Generator, Args...>::setDone),
+    &BestFirst<Generator, Args...>::setDone,
+    SetDoneAct>::type {};
+
+  // Share nodes with the locality frontier. We keep it stocked for idle
+  // workers/thieves and swap in any node that is better than our own best.
+  static void exchange(Heap & local) {
+    auto frontier = getFrontier();
+    std::lock_guard<typename Frontier::MutexT> l(frontier->mtx);
+    auto & shared = frontier->heap;
+
+    if (frontier->idleWorkers > 0 || shared.size() < frontier->numWorkers) {
+      for (auto i = 0; i < exchangeSize && local.size() > 1; ++i) {
+        shared.push(local.pop());
+      }
+      return;
+    }
+
+    Objcmp cmp;
+    if (!shared.empty() && !local.empty() && cmp(shared.top().bnd, local.top().bnd)) {
+      auto better = shared.pop();
+      shared.push(local.pop());
+      local.push(std::move(better));
+    }
+  }
+
+  // Refill an empty local heap from the locality frontier or, failing that, a
+  // random remote locality. Tracks idleness for termination detection.
+  static bool getWork(Heap & local, bool & idle) {
+    auto frontier = getFrontier();
+    hpx::id_type victim;
+    {
+      std::lock_guard<typename Frontier::MutexT> l(frontier->mtx);
+      if (!frontier->heap.empty()) {
+        for (auto i = 0; i < exchangeSize && !frontier->heap.empty(); ++i) {
+          local.push(frontier->heap.pop());
+        }
+        if (idle) {
+          frontier->idleWorkers--;
+          frontier->epoch++;
+          idle = false;
+        }
+        return true;
+      }
+
+      if (!idle) {
+        frontier->idleWorkers++;
+        idle = true;
+      }
+
+      if (frontier->remotes.empty() || frontier->isStealingDistributed) {
+        return false;
+      }
+
+      // We count as active while stealing so that termination can't be
+      // detected while nodes are in flight
+      frontier->isStealingDistributed = true;
+      frontier->idleWorkers--;
+      frontier->epoch++;
+      idle = false;
+
+      std::uniform_int_distribution<> rand(0, frontier->remotes.size() - 1);
+      victim = frontier->remotes[rand(frontier->randGenerator)];
+    }
+
+    auto stolen = hpx::async<StealNodesAct>(victim, Context::current(), exchangeSize).get();
+
+    std::lock_guard<typename Frontier::MutexT> l(frontier->mtx);
+    frontier->isStealingDistributed = false;
+    if (stolen.empty()) {
+      frontier->idleWorkers++;
+      idle = true;
+      return false;
+    }
+
+    for (auto & n : stolen) {
+      local.push(std::move(n));
+    }
+    return true;
+  }
+
+  static void worker(const Context::Id ctx) {
+    Context::Scope scope(ctx);
+    auto reg = Registry<Space, Node, Bound, Enum>::get();
+    auto frontier = getFrontier();
+    const auto & space = reg->space;
+    const auto & params = reg->params;
+
+    Heap local;
+    Enum acc;
+    bool idle = false;
+    unsigned expansions = 0;
+
+    while (!frontier->done) {
+      if constexpr(isDecision) {
+        if (reg->stopSearch) {
+          break;
+        }
+      }
+
+      if (local.empty()) {
+        if (!getWork(local, idle)) {
+          hpx::this_thread::suspend(std::chrono::microseconds(100));
+        }
+        continue;
+      }
+
+      if (++expansions % exchangeInterval == 0) {
+        exchange(local);
+      }
+
+      auto n = local.pop();
+
+      // The heap is ordered by bound so if the best node can't beat the
+      // incumbent then nothing else in the heap can either
+      if constexpr(isOptimisation) {
+        Objcmp cmp;
+        if (!cmp(n.bnd, reg->localBound.load())) {
+          local.clear();
+          continue;
+        }
+      }
+
+      if constexpr(isDepthLimited) {
+        if (n.depth == params.maxDepth) {
+          continue;
+        }
+      }
+
+      Generator newCands(space, n.node);
+      for (auto i = 0; i < newCands.numChildren; ++i) {
+        auto c = newCands.next();
+
+        Bound bnd;
+        auto pn = ProcessNode<Space, Node, Args...>::processNode(params, space, c, acc, &bnd);
+        if (pn == ProcessNodeRet::Exit) { return; }
+        else if (pn == ProcessNodeRet::Prune) { continue; }
+        else if (pn == ProcessNodeRet::Break) { break; }
+
+        local.push(OpenNode{bnd, n.depth + 1, std::move(c)});
+      }
+    }
+  }
+
+  // Run this locality's workers until the search is done
+  static void runWorkers(Context::Id ctx) {
+    auto n = getFrontier(ctx)->numWorkers;
+    hpx::execution::parallel_executor exe(hpx::threads::thread_priority::critical,
+                                          hpx::threads::thread_stacksize::huge);
+    std::vector<hpx::future<void> > futs;
+    for (auto i = 0; i < n; ++i) {
+      futs.push_back(hpx::async(exe, &worker, ctx));
+    }
+    hpx::wait_all(futs);
+  }
+  struct RunWorkersAct : hpx::actions::make_action<
+    decltype(&BestFirst<Generator, Args...>::runWorkers),
+    &BestFirst<Generator, Args...>::runWorkers,
+    RunWorkersAct>::type {};
+
+  // Double check termination: every locality must be idle in two consecutive
+  // polls with no worker having become active in between.
+  static void waitForTermination() {
+    auto reg = Registry<Space, Node, Bound, Enum>::get();
+    auto localities = hpx::find_all_localities();
+    std::vector<std::int64_t> lastEpochs;
+
+    while (true) {
+      hpx::this_thread::suspend(terminationPoll);
+
+      if constexpr(isDecision) {
+        if (reg->stopSearch) {
+          return;
+        }
+      }
+
+      std::vector<hpx::future<std::int64_t> > futs;
+      for (const auto & l : localities) {
+        futs.push_back(hpx::async<GetIdleEpochAct>(l, reg->ctx));
+      }
+      std::vector<std::int64_t> epochs;
+      for (auto & f : futs) {
+        epochs.push_back(f.get());
+      }
+
+      auto allIdle = std::none_of(epochs.begin(), epochs.end(), [](std::int64_t e) { return e < 0; });
+      if (allIdle && epochs == lastEpochs) {
+        return;
+      }
+      lastEpochs = allIdle ? epochs : std::vector<std::int64_t>();
+    }
+  }
+
+  static auto search (const Space & space,
+                      const Node & root,
+                      const API::Params<Bound> params = API::Params<Bound>()) {
+    static_assert(isOptimisation || isDecision, "BestFirst supports Optimisation and Decision searches only");
+    static_assert(!std::is_same<boundFn, nullFn__>::value, "BestFirst requires a BoundFunction to order the frontier");
+
+    if constexpr(verbose) {
+      printSkeletonDetails();
+    }
+
+    Context::SearchScope ctx;
+
+    hpx::wait_all(hpx::lcos::broadcast<InitRegistryAct<Space, Node, Bound, Enum> >(
+        hpx::find_all_localities(), ctx.id(), space, root, params));
+
+    auto inc = hpx::new_<Incumbent>(hpx::find_here()).get();
+    hpx::wait_all(hpx::lcos::broadcast<UpdateGlobalIncumbentAct<Space, Node, Bound, Enum> >(
+        hpx::find_all_localities(), ctx.id(), inc));
+    initIncumbent<Space, Node, Bound, Enum, Objcmp, Verbose>(root, params.initialBound);
+
+    hpx::wait_all(hpx::lcos::broadcast<InitFrontierAct>(hpx::find_all_localities(), ctx.id()));
+
+    pushRoot(root, boundFn::invoke(space, root));
+
+    auto workersDone = hpx::lcos::broadcast<RunWorkersAct>(hpx::find_all_localities(), ctx.id());
+
+    waitForTermination();
+
+    hpx::wait_all(hpx::lcos::broadcast<SetDoneAct>(hpx::find_all_localities(), ctx.id()));
+    workersDone.get();
+
+    return getIncumbent<Space, Node, Bound, Enum, Objcmp, Verbose>();
+  }
+};
+
+}}
+
+#endif
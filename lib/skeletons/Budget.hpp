@@ -1,9 +1,17 @@
 #ifndef SKELETONS_BUDGET_HPP
 #define SKELETONS_BUDGET_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <tuple>
+
 #include <hpx/iostream.hpp>
 #include <hpx/collectives/broadcast.hpp>
 
+#include "util/Termination.hpp"
+
 #include <boost/format.hpp>
 
 namespace YewPar { namespace Skeletons {
@@ -38,6 +46,83 @@ struct Budget {
 
   typedef typename parameter::value_type<args, API::tag::DepthBoundedPoolPolicy, Workstealing::Policies::DepthPoolPolicy>::type Policy;
 
+  // Adaptive budgets stay within these limits and are re-tuned at most once
+  // per budgetUpdateInterval on each locality
+  static constexpr unsigned minBudget = 16;
+  static constexpr unsigned maxBudget = 1u << 24;
+  static constexpr std::chrono::milliseconds budgetUpdateInterval{10};
+
+  struct BudgetState {
+    std::atomic<unsigned> budget {0};
+
+    // Set while a thread is re-tuning the budget
+    std::atomic<bool> updating {false};
+
+    // Policy counter values at the last update
+    std::uint64_t lastSpawns = 0;
+    std::uint64_t lastSteals = 0;
+    std::uint64_t lastFailedSteals = 0;
+    std::chrono::steady_clock::time_point lastUpdate;
+  };
+
+  // Per search context, like the registry
+  static BudgetState * budgetState(Context::Id ctx = Context::current()) {
+    static Context::PerContext<BudgetState> states;
+    return &states.get(ctx);
+  }
+
+  static void initBudgetState(const Context::Id ctx, const unsigned initialBudget) {
+    auto st = budgetState(ctx);
+    st->budget = initialBudget;
+    st->updating = false;
+    std::tie(st->lastSpawns, st->lastSteals, st->lastFailedSteals) = Policy::getLoadCounters();
+    st->lastUpdate = std::chrono::steady_clock::now();
+  }
+  struct InitBudgetStateAct : hpx::actions::make_action<
+    decltype(&Budget<Generator, Args...>::initBudgetState),
+    &Budget<Generator, Args...>::initBudgetState,
+    InitBudgetStateAct>::type {};
+
+  // Called when a task exhausts its budget. If steals are failing then workers
+  // are starving and we should split sooner. If tasks are spawned much faster
+  // than they are stolen the pools are well stocked and tasks can be larger.
+  static unsigned adaptBudget() {
+    auto st = budgetState();
+    auto budget = st->budget.load();
+
+    // Only one thread re-tunes at a time, everyone else keeps the current value
+    if (st->updating.exchange(true)) {
+      return budget;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - st->lastUpdate >= budgetUpdateInterval) {
+      std::uint64_t spawns, steals, failedSteals;
+      std::tie(spawns, steals, failedSteals) = Policy::getLoadCounters();
+
+      // Counters can be reset through the performance counter API
+      auto delta = [](std::uint64_t cur, std::uint64_t last) { return cur >= last ? cur - last : cur; };
+      auto newSpawns = delta(spawns, st->lastSpawns);
+      auto newSteals = delta(steals, st->lastSteals);
+      auto newFailedSteals = delta(failedSteals, st->lastFailedSteals);
+
+      if (newFailedSteals > newSteals) {
+        budget = std::max(minBudget, budget / 2);
+      } else if (newSpawns > 2 * newSteals) {
+        budget = std::min(maxBudget, budget * 2);
+      }
+      st->budget.store(budget);
+
+      st->lastSpawns = spawns;
+      st->lastSteals = steals;
+      st->lastFailedSteals = failedSteals;
+      st->lastUpdate = now;
+    }
+
+    st->updating.store(false);
+    return budget;
+  }
+
   static void printSkeletonDetails() {
     hpx::cout << "Skeleton Type: Budget\n";
     hpx::cout << "Enumeration : " << std::boolalpha << isEnumeration << "\n";
@@ -53,6 +138,8 @@ struct Budget {
     }
     if constexpr (std::is_same<Policy, Workstealing::Policies::Workpool>::value) {
         hpx::cout << "Workpool: Deque\n";
+      } else if constexpr (std::is_same<Policy, Workstealing::Policies::WorkerDequePool>::value) {
+        hpx::cout << "Workpool: WorkerDeques\n";
       } else {
       hpx::cout << "Workpool: DepthPool\n";
     }
@@ -63,16 +150,16 @@ struct Budget {
                      const Node & n,
                      const API::Params<Bound> & params,
                      Enum & acc,
-                     std::vector<hpx::future<void> > & childFutures,
                      const unsigned childDepth) {
-    auto reg = Registry<Space, Node, Bound, Enum>::gReg;
+    auto reg = Registry<Space, Node, Bound, Enum>::get();
 
     auto depth = childDepth;
     auto backtracks = 0;
+    unsigned budget = params.adaptiveBudget ? budgetState()->budget.load() : params.backtrackBudget;
 
     // Init the stack
-    StackElem<Generator> initElem(space, n);
-    GeneratorStack<Generator> genStack(maxStackDepth, initElem);
+    auto stack = GeneratorStack<Generator>::acquire(space, n);
+    auto & genStack = *stack;
 
     // Count the initial element
     if (isEnumeration) {
@@ -89,23 +176,26 @@ struct Budget {
       }
 
       // We spawn when we have exhausted our backtrack budget
-      if (backtracks == params.backtrackBudget) {
+      if (backtracks >= budget) {
         // Spawn everything at the highest possible depth
         for (auto i = 0; i < stackDepth; ++i) {
           if (genStack[i].seen < genStack[i].gen.numChildren) {
             while (genStack[i].seen < genStack[i].gen.numChildren) {
               genStack[i].seen++;
-              childFutures.push_back(createTask(childDepth + i + 1, genStack[i].gen.next()));
+              createTask(childDepth + i + 1, genStack[i].gen.next());
             }
           }
         }
         backtracks = 0;
+
+        if (params.adaptiveBudget) {
+          budget = adaptBudget();
+        }
       }
 
       // If there's still children at this stackDepth we move into them
       if (genStack[stackDepth].seen < genStack[stackDepth].gen.numChildren) {
-        genStack[stackDepth + 1].node = genStack[stackDepth].gen.next();
-        const auto & child = genStack[stackDepth + 1].node;
+        auto child = genStack[stackDepth].gen.next();
 
         genStack[stackDepth].seen++;
 
@@ -119,24 +209,19 @@ struct Budget {
           continue;
         }
 
-        // Going down
-        const auto childGen = Generator(space, child);
-        stackDepth++;
-        depth++;
-
         // TODO: This only works correctly for countNodes where we can count without going into a node
         // It wouldn't work for a depthBounded optimisation problem for example.
         if constexpr(isDepthBounded) {
-          if (depth == reg->params.maxDepth) {
-            stackDepth--;
-            depth--;
+          if (depth + 1 == reg->params.maxDepth) {
             backtracks++;
             continue;
           }
         }
 
-        genStack[stackDepth].seen = 0;
-        genStack[stackDepth].gen = childGen;
+        // Going down
+        stackDepth++;
+        depth++;
+        genStack.place(stackDepth, space, std::move(child));
       } else {
         stackDepth--;
         depth--;
@@ -145,43 +230,39 @@ struct Budget {
     }
   }
 
-  static void subtreeTask(const Node taskRoot,
-                          const unsigned childDepth,
-                          const hpx::id_type donePromiseId) {
-    auto reg = Registry<Space, Node, Bound, Enum>::gReg;
+  static void subtreeTask(const Context::Id ctx,
+                          const Node taskRoot,
+                          const unsigned childDepth) {
+    Context::Scope scope(ctx);
+    auto reg = Registry<Space, Node, Bound, Enum>::get();
 
     Enum acc;
 
-    std::vector<hpx::future<void> > childFutures;
-    expand(reg->space, taskRoot, reg->params, acc, childFutures, childDepth);
+    expand(reg->space, taskRoot, reg->params, acc, childDepth);
 
-    // Atomically updates the (process) local counter
+    // Adds to this worker thread's (process local) counter
     if constexpr (isEnumeration) {
       reg->updateEnumerator(acc);
     }
 
-    termination_wait_act act;
-    hpx::post(act, hpx::find_here(), std::move(childFutures), donePromiseId);
+    // Children were all counted when they were created
+    Termination::taskCompleted();
   }
 
-  static hpx::future<void> createTask(const unsigned childDepth,
-                                      const Node & taskRoot) {
-    hpx::distributed::promise<void> prom;
-    auto pfut = prom.get_future();
-    auto pid  = prom.get_id();
+  static void createTask(const unsigned childDepth,
+                         const Node & taskRoot) {
+    Termination::taskCreated();
 
     detail::BudgetSubtreeTask<Generator, Args...> t;
     hpx::distributed::function<void(hpx::id_type)> task;
-    task = hpx::bind(t, hpx::placeholders::_1, taskRoot, childDepth, pid);
+    task = hpx::bind(t, hpx::placeholders::_1, Context::current(), taskRoot, childDepth);
 
-    auto workPool = std::static_pointer_cast<Policy>(Workstealing::Scheduler::local_policy);
-    if constexpr (std::is_same<Policy, Workstealing::Policies::Workpool>::value) {
-      workPool->addwork(task);
-    } else {
+    auto workPool = std::static_pointer_cast<Policy>(Workstealing::Scheduler::getPolicy());
+    if constexpr (std::is_same<Policy, Workstealing::Policies::DepthPoolPolicy>::value) {
       workPool->addwork(task, childDepth - 1);
+    } else {
+      workPool->addwork(task);
     }
-
-    return pfut;
   }
 
   static auto search (const Space & space,
@@ -191,35 +272,39 @@ struct Budget {
       printSkeletonDetails();
     }
 
+    Context::SearchScope ctx;
+
     hpx::wait_all(hpx::lcos::broadcast<InitRegistryAct<Space, Node, Bound, Enum> >(
-        hpx::find_all_localities(), space, root, params));
+        hpx::find_all_localities(), ctx.id(), space, root, params));
 
     Policy::initPolicy();
 
-    auto threadCount = hpx::get_os_thread_count() == 1 ? 1 : hpx::get_os_thread_count() - 1;
-    hpx::wait_all(hpx::lcos::broadcast<Workstealing::Scheduler::startSchedulers_act>(
-        hpx::find_all_localities(), threadCount));
+    if (params.adaptiveBudget) {
+      hpx::wait_all(hpx::lcos::broadcast<InitBudgetStateAct>(
+          hpx::find_all_localities(), ctx.id(), params.backtrackBudget));
+    }
+
+    hpx::wait_all(hpx::lcos::broadcast<Workstealing::Scheduler::startLocalSchedulers_act>(
+        hpx::find_all_localities()));
 
     if constexpr(isOptimisation || isDecision) {
       auto inc = hpx::new_<Incumbent>(hpx::find_here()).get();
       hpx::wait_all(hpx::lcos::broadcast<UpdateGlobalIncumbentAct<Space, Node, Bound, Enum> >(
-          hpx::find_all_localities(), inc));
+          hpx::find_all_localities(), ctx.id(), inc));
       initIncumbent<Space, Node, Bound, Enum, Objcmp, Verbose>(root, params.initialBound);
     }
 
-    createTask(1, root).get();
+    createTask(1, root);
+    Termination::waitForTermination();
 
     hpx::wait_all(hpx::lcos::broadcast<Workstealing::Scheduler::stopSchedulers_act>(
-        hpx::find_all_localities()));
+        hpx::find_all_localities(), ctx.id()));
 
     // Return the right thing
     if constexpr(isEnumeration) {
       return combineEnumerators<Space, Node, Bound, Enum>();
     } else if constexpr(isOptimisation || isDecision) {
-      auto reg = Registry<Space, Node, Bound, Enum>::gReg;
-
-      typedef typename Incumbent::GetIncumbentAct<Node, Bound, Objcmp, Verbose> getInc;
-      return hpx::async<getInc>(reg->globalIncumbent).get();
+      return getIncumbent<Space, Node, Bound, Enum, Objcmp, Verbose>();
     } else {
       static_assert(isEnumeration || isOptimisation || isDecision, "Please provide a supported search type: Enumeration, Optimisation, Decision");
     }
@@ -1,8 +1,20 @@
 #ifndef SKELETONS_COMMON_HPP
 #define SKELETONS_COMMON_HPP
 
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <random>
+#include <vector>
+
 #include <hpx/runtime_distributed/find_all_localities.hpp>
 #include <hpx/modules/collectives.hpp>
+#include <hpx/iostream.hpp>
+#include <hpx/thread.hpp>
+
+#include <boost/format.hpp>
 
 #include "util/Registry.hpp"
 #include "util/Incumbent.hpp"
@@ -12,7 +24,7 @@ namespace YewPar { namespace Skeletons {
 
 template<typename Space, typename Node, typename Bound, typename Enum, typename Cmp, typename Verbose>
 static void initIncumbent(const Node & node, const Bound & bnd) {
-  auto reg = Registry<Space, Node, Bound, Enum>::gReg;
+  auto reg = Registry<Space, Node, Bound, Enum>::get();
 
   typedef typename Incumbent::InitComponentAct<Node, Bound, Cmp, Verbose> initComp;
   hpx::async<initComp>(reg->globalIncumbent).get();
@@ -21,44 +33,276 @@ static void initIncumbent(const Node & node, const Bound & bnd) {
   hpx::async<initVals>(reg->globalIncumbent, node, bnd).get();
 }
 
+// Improvements found on a locality within this window are sent as one update
+constexpr std::chrono::microseconds incumbentFlushWindow {200};
+
+// Runs (at most one per locality) after an improvement is found. Waits out the
+// window and then sends the locality's best bound to every other locality,
+// unless a better bound has arrived from elsewhere in the meantime.
+template<typename Space, typename Node, typename Bound, typename Enumerator, typename Cmp>
+static void flushIncumbentBound(Context::Id ctx) {
+  auto reg = Registry<Space, Node, Bound, Enumerator>::get(ctx);
+  Cmp cmp;
+
+  auto bestBound = [&]() {
+    std::lock_guard<typename Registry<Space, Node, Bound, Enumerator>::MutexT> l(reg->bestMtx);
+    return reg->bestBound;
+  };
+  auto worthSending = [&](const Bound & bnd) {
+    return cmp(bnd, reg->lastSentBound) && !cmp(reg->localBound.load(), bnd);
+  };
+
+  for (;;) {
+    hpx::this_thread::sleep_for(incumbentFlushWindow);
+
+    auto bnd = bestBound();
+    if (worthSending(bnd)) {
+      reg->lastSentBound = bnd;
+      hpx::async<PropagateBoundAct<Space, Node, Bound, Enumerator, Cmp> >(
+          hpx::find_here(), ctx, bnd, reg->localityRank).get();
+    }
+
+    reg->flushPending.store(false);
+
+    // An improvement found while we were sending didn't schedule a flush
+    if (!worthSending(bestBound()) || reg->flushPending.exchange(true)) {
+      return;
+    }
+  }
+}
+
+// Called by search threads on finding a better node. This never blocks: the
+// bound is used locally straight away and propagated asynchronously, and the
+// node itself stays on this locality until uploadIncumbent.
 template<typename Space, typename Node, typename Bound, typename Enumerator, typename Cmp, typename Verbose>
 static void updateIncumbent(const Node & node, const Bound & bnd) {
-  auto reg = Registry<Space, Node, Bound, Enumerator>::gReg;
+  auto reg = Registry<Space, Node, Bound, Enumerator>::get();
 
   (*reg).template updateRegistryBound<Cmp>(bnd);
-  hpx::lcos::broadcast<UpdateRegistryBoundAct<Space, Node, Bound, Enumerator, Cmp> >(
-      hpx::find_all_localities(), bnd);
 
-  typedef typename Incumbent::UpdateIncumbentAct<Node, Bound, Cmp, Verbose> act;
-  hpx::async<act>(reg->globalIncumbent, node).get();
+  if (!(*reg).template updateBestNode<Cmp>(node, bnd)) {
+    return;
+  }
+
+  if constexpr(Verbose::value >= 1) {
+    hpx::cout << (boost::format("New Incumbent Bound: %1%\n") % bnd) << std::flush;
+  }
+
+  if (!reg->flushPending.exchange(true)) {
+    hpx::post(&flushIncumbentBound<Space, Node, Bound, Enumerator, Cmp>, reg->ctx);
+  }
+}
+
+// Send this locality's best node to the global incumbent, once any pending
+// bound propagation has finished (so none outlives the search)
+template<typename Space, typename Node, typename Bound, typename Enumerator, typename Cmp, typename Verbose>
+static void uploadIncumbent(Context::Id ctx) {
+  auto reg = Registry<Space, Node, Bound, Enumerator>::get(ctx);
+
+  while (reg->flushPending.load()) {
+    hpx::this_thread::yield();
+  }
+
+  if (reg->haveBestNode) {
+    typedef typename Incumbent::UpdateIncumbentAct<Node, Bound, Cmp, Verbose> act;
+    hpx::async<act>(reg->globalIncumbent, reg->bestNode).get();
+  }
+}
+template<typename Space, typename Node, typename Bound, typename Enumerator, typename Cmp, typename Verbose>
+struct UploadIncumbentAct : hpx::actions::make_action<
+  decltype(&uploadIncumbent<Space, Node, Bound, Enumerator, Cmp, Verbose>),
+  &uploadIncumbent<Space, Node, Bound, Enumerator, Cmp, Verbose>,
+  UploadIncumbentAct<Space, Node, Bound, Enumerator, Cmp, Verbose> >::type {};
+
+// Collect the best node from every locality, call once the search has ended
+template<typename Space, typename Node, typename Bound, typename Enumerator, typename Cmp, typename Verbose>
+static Node getIncumbent() {
+  auto reg = Registry<Space, Node, Bound, Enumerator>::get();
+
+  hpx::wait_all(hpx::lcos::broadcast<UploadIncumbentAct<Space, Node, Bound, Enumerator, Cmp, Verbose> >(
+      hpx::find_all_localities(), reg->ctx));
+
+  typedef typename Incumbent::GetIncumbentAct<Node, Bound, Cmp, Verbose> getInc;
+  return hpx::async<getInc>(reg->globalIncumbent).get();
 }
 
 template<typename Space, typename Node, typename Bound, typename Enum>
 static typename Enum::ResT combineEnumerators() {
-  auto vals = hpx::lcos::broadcast<GetEnumeratorValAct<Space, Node, Bound, Enum> >(
-    hpx::find_all_localities()).get();
+  auto reg = Registry<Space, Node, Bound, Enum>::get();
+  return reduceEnumerators<Space, Node, Bound, Enum>(reg->ctx, reg->localityRank);
+}
+
+// Knuth style estimate of the shallowest depth with at least target nodes. Each
+// probe follows a random path from the root and the product of the branching
+// factors seen gives an unbiased estimate of the width of each level. Pruning
+// is ignored so this over-estimates the width of B&B trees.
+template <typename Generator>
+static unsigned estimateSpawnDepth(const typename Generator::Spacetype & space,
+                                   const typename Generator::Nodetype & root,
+                                   const std::uint64_t target,
+                                   const unsigned maxSpawnDepth,
+                                   const unsigned numProbes = 64) {
+  std::vector<double> widths(maxSpawnDepth + 1, 0.0);
+
+  // Fixed seed so that repeated runs choose the same depth
+  std::mt19937 randGenerator(0);
+
+  for (auto p = 0; p < numProbes; ++p) {
+    auto n = root;
+    double width = 1;
+    for (auto d = 1; d <= maxSpawnDepth; ++d) {
+      Generator gen(space, n);
+      if (gen.numChildren == 0) {
+        break;
+      }
+
+      width *= gen.numChildren;
+      widths[d] += width;
+
+      // This probe alone pushes the average at depth d past the target, so
+      // deeper levels can't change the answer
+      if (width >= static_cast<double>(target) * numProbes) {
+        break;
+      }
+
+      std::uniform_int_distribution<unsigned> rand(0, gen.numChildren - 1);
+      n = gen.nth(rand(randGenerator));
+    }
+  }
+
+  for (auto d = 1; d <= maxSpawnDepth; ++d) {
+    if (widths[d] / numProbes >= target) {
+      return d;
+    }
+  }
+  return maxSpawnDepth;
+}
+
+// Knuth style estimate of the size of the subtree rooted at n, averaged over
+// numProbes random probes. The variance is high on irregular trees so this is
+// only good for rough comparisons between subtrees.
+template <typename Generator>
+static double estimateSubtreeSize(const typename Generator::Spacetype & space,
+                                  const typename Generator::Nodetype & n,
+                                  const unsigned maxDepth,
+                                  const unsigned numProbes = 8) {
+  std::mt19937 randGenerator(0);
 
-  Enum res;
-  for (const auto v : vals) {
-    res.combine(v);
+  double total = 0;
+  for (auto p = 0; p < numProbes; ++p) {
+    auto cur = n;
+    double width = 1;
+    total += 1;
+    for (auto d = 0; d < maxDepth; ++d) {
+      Generator gen(space, cur);
+      if (gen.numChildren == 0) {
+        break;
+      }
+
+      width *= gen.numChildren;
+      total += width;
+
+      std::uniform_int_distribution<unsigned> rand(0, gen.numChildren - 1);
+      cur = gen.nth(rand(randGenerator));
+    }
   }
-  return res.get();
+  return total / numProbes;
 }
 
 template <typename Generator>
 struct StackElem {
   unsigned seen;
+  // Index of the child the level above is exploring. Only kept up to date by
+  // skeletons that need paths (Indexed): seen moves on as children are stolen.
+  unsigned current;
   typename Generator::Nodetype node;
   Generator gen;
 
-  StackElem(Generator gen) : seen(0), gen(gen) {};
+  StackElem(Generator gen) : seen(0), current(0), gen(gen) {};
   StackElem(const typename Generator::Spacetype & s,
             const typename Generator::Nodetype & n)
-      : seen(0), node(n), gen(Generator(s, node)) {};
+      : seen(0), current(0), node(n), gen(Generator(s, node)) {};
+  StackElem(const typename Generator::Spacetype & s,
+            typename Generator::Nodetype && n)
+      : seen(0), current(0), node(std::move(n)), gen(Generator(s, node)) {};
 };
 
+// Explicit search stack for the stack based skeletons. Levels are only
+// allocated once the search first reaches them and never move afterwards, so
+// generators may keep references to their parent node. Descending constructs
+// the child's element in place rather than copy assigning a generator.
+//
+// Stacks are recycled through a per OS thread free list (see acquire) so a
+// worker running many small tasks reuses the levels it has already allocated.
 template <typename Generator>
-using GeneratorStack = std::vector<StackElem<Generator>>;
+class GeneratorStack {
+ public:
+  typedef StackElem<Generator> Elem;
+  typedef typename Generator::Nodetype Node;
+  typedef typename Generator::Spacetype Space;
+
+  struct Recycle {
+    void operator()(GeneratorStack * s) const {
+      s->clear();
+      auto & pool = freeList();
+      if (pool.size() < maxPooled) {
+        pool.emplace_back(s);
+      } else {
+        delete s;
+      }
+    }
+  };
+  using Handle = std::unique_ptr<GeneratorStack, Recycle>;
+
+  GeneratorStack() = default;
+  GeneratorStack(const GeneratorStack &) = delete;
+  GeneratorStack & operator=(const GeneratorStack &) = delete;
+
+  // A stack with the given root at level 0. Tasks may resume on a different OS
+  // thread than they started on, in which case the stack is simply returned to
+  // that thread's free list.
+  static Handle acquire(const Space & space, const Node & root) {
+    auto & pool = freeList();
+    GeneratorStack * s;
+    if (pool.empty()) {
+      s = new GeneratorStack();
+    } else {
+      s = pool.back().release();
+      pool.pop_back();
+    }
+    s->place(0, space, root);
+    return Handle(s);
+  }
+
+  Elem & operator[](const std::size_t i) { return **levels[i]; }
+  const Elem & operator[](const std::size_t i) const { return **levels[i]; }
+
+  // (Re)construct level i around node n, replacing anything already there
+  template <typename N>
+  Elem & place(const std::size_t i, const Space & space, N && n) {
+    while (levels.size() <= i) {
+      levels.push_back(std::make_unique<std::optional<Elem> >());
+    }
+    return levels[i]->emplace(space, std::forward<N>(n));
+  }
+
+  // Release the nodes and generators held by each level but keep the storage
+  void clear() {
+    for (auto & l : levels) {
+      l->reset();
+    }
+  }
+
+ private:
+  static constexpr std::size_t maxPooled = 4;
+
+  static std::vector<std::unique_ptr<GeneratorStack> > & freeList() {
+    static thread_local std::vector<std::unique_ptr<GeneratorStack> > pool;
+    return pool;
+  }
+
+  std::vector<std::unique_ptr<std::optional<Elem> > > levels;
+};
 
 // General node processing
 enum ProcessNodeRet { Exit, Prune, Break, Continue };
@@ -80,10 +324,13 @@ struct ProcessNode {
 
   typedef typename parameter::value_type<args, API::tag::Enumerator, IdentityEnumerator<Node>>::type Enumerator;
 
+  // If bndOut is given the computed bound of c is written to it, saving
+  // callers that order nodes by bound from calling boundFn twice
   static ProcessNodeRet processNode(const API::Params<Bound> & params,
                                     const Space & space,
                                     const Node & c,
-                                    Enumerator & acc) {
+                                    Enumerator & acc,
+                                    Bound * bndOut = nullptr) {
 
     if constexpr(isEnumeration) {
         acc.accumulate(c);
@@ -93,7 +340,7 @@ struct ProcessNode {
     if constexpr(isDecision) {
         if (c.getObj() == params.expectedObjective) {
           updateIncumbent<Space, Node, Bound, Enumerator, Objcmp, Verbose>(c, c.getObj());
-          hpx::lcos::broadcast<SetStopFlagAct<Space, Node, Bound, Enumerator> >(hpx::find_all_localities());
+          hpx::lcos::broadcast<SetStopFlagAct<Space, Node, Bound, Enumerator> >(hpx::find_all_localities(), Context::current());
           return ProcessNodeRet::Exit;
         }
       }
@@ -101,6 +348,9 @@ struct ProcessNode {
     if constexpr(!std::is_same<boundFn, nullFn__>::value) {
         Objcmp cmp;
         auto bnd  = boundFn::invoke(space, c);
+        if (bndOut) {
+          *bndOut = bnd;
+        }
         if constexpr(isDecision) {
             if (!cmp(bnd, params.expectedObjective) && bnd != params.expectedObjective) {
               if constexpr(pruneLevel) {
@@ -111,7 +361,7 @@ struct ProcessNode {
             }
             // B&B Case
           } else {
-          auto reg = Registry<Space, Node, Bound, Enumerator>::gReg;
+          auto reg = Registry<Space, Node, Bound, Enumerator>::get();
           auto best = reg->localBound.load();
           if (!cmp(bnd, best)) {
             if constexpr(pruneLevel) {
@@ -124,7 +374,7 @@ struct ProcessNode {
       }
 
     if constexpr(isOptimisation) {
-        auto reg = Registry<Space, Node, Bound, Enumerator>::gReg;
+        auto reg = Registry<Space, Node, Bound, Enumerator>::get();
         auto best = reg->localBound.load();
 
         Objcmp cmp;
@@ -136,14 +386,131 @@ struct ProcessNode {
   }
 };
 
-  void termination_wait(std::vector<hpx::future<void>> && futs, hpx::id_type donePromiseId) {
-        hpx::wait_all(futs);
-        hpx::async<hpx::lcos::base_lco_with_value<void>::set_value_action>(donePromiseId, true);
+// Depth first search below a task root using an explicit stack of generators
+// rather than recursion, so tasks don't need huge stacks however deep the tree
+// goes. Levels live in a deque since growing it never moves existing levels
+// (generators may hold a reference to their parent node).
+template <typename Generator, typename ...Args>
+struct DepthFirst {
+  typedef typename Generator::Nodetype Node;
+  typedef typename Generator::Spacetype Space;
+
+  typedef ProcessNode<Space, Node, Args...> PN;
+  typedef typename PN::Bound Bound;
+  typedef typename PN::Enumerator Enum;
+
+  typedef typename API::skeleton_signature::bind<Args...>::type args;
+  static constexpr bool isDecision = parameter::value_type<args, API::tag::Decision_, std::integral_constant<bool, false> >::type::value;
+  static constexpr bool isDepthLimited = parameter::value_type<args, API::tag::DepthLimited_, std::integral_constant<bool, false> >::type::value;
+
+  struct Level {
+    Node node;
+    Generator gen;
+    unsigned seen;
+
+    Level(const Space & space, const Node & n)
+        : node(n), gen(Generator(space, node)), seen(0) {};
+  };
+
+  static void expandNoSpawns(const Space & space,
+                             const Node & n,
+                             const API::Params<Bound> & params,
+                             Enum & acc,
+                             const unsigned childDepth) {
+    expand(space, n, params, acc, childDepth,
+           []() { return false; },
+           [](const Node &, const unsigned) {});
   }
 
+  // After each child is processed shouldSplit() is asked whether to give work
+  // away. If so the rest of the shallowest level with children left, likely
+  // the largest subtrees, goes to spawn(child, childDepth) instead of being
+  // searched here.
+  template <typename SplitFn, typename SpawnFn>
+  static void expand(const Space & space,
+                     const Node & n,
+                     const API::Params<Bound> & params,
+                     Enum & acc,
+                     const unsigned childDepth,
+                     SplitFn && shouldSplit,
+                     SpawnFn && spawn) {
+    auto reg = Registry<Space, Node, Bound, Enum>::get();
 
-}}
+    if constexpr(isDepthLimited) {
+        if (childDepth == params.maxDepth) {
+          return;
+        }
+    }
 
-HPX_PLAIN_ACTION(YewPar::Skeletons::termination_wait, termination_wait_act);
+    std::deque<Level> stack;
+    stack.emplace_back(space, n);
+
+    // The depth of the children of the top level
+    auto depth = childDepth;
+
+    while (!stack.empty()) {
+      if constexpr(isDecision) {
+        if (reg->stopSearch) {
+          return;
+        }
+      }
+
+      auto & top = stack.back();
+      if (top.seen == top.gen.numChildren) {
+        stack.pop_back();
+        --depth;
+        continue;
+      }
+
+      auto c = top.gen.next();
+      ++top.seen;
+
+      auto pn = PN::processNode(params, space, c, acc);
+      if (pn == ProcessNodeRet::Exit) { return; }
+      else if (pn == ProcessNodeRet::Prune) { continue; }
+      else if (pn == ProcessNodeRet::Break) {
+        stack.pop_back();
+        --depth;
+        continue;
+      }
+
+      if (shouldSplit()) {
+        for (auto i = 0; i < stack.size(); ++i) {
+          auto & l = stack[i];
+          if (l.seen == l.gen.numChildren) {
+            continue;
+          }
+
+          while (l.seen < l.gen.numChildren) {
+            auto s = l.gen.next();
+            ++l.seen;
+
+            auto spn = PN::processNode(params, space, s, acc);
+            if (spn == ProcessNodeRet::Exit) { return; }
+            else if (spn == ProcessNodeRet::Prune) { continue; }
+            else if (spn == ProcessNodeRet::Break) {
+              l.seen = l.gen.numChildren;
+              break;
+            }
+
+            spawn(s, childDepth + i + 1);
+          }
+          break;
+        }
+      }
+
+      if constexpr(isDepthLimited) {
+        if (depth + 1 == params.maxDepth) {
+          continue;
+        }
+      }
+
+      stack.emplace_back(space, c);
+      ++depth;
+    }
+  }
+};
+
+}}
 
 #endif
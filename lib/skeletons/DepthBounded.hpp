@@ -16,11 +16,14 @@
 #include "util/Registry.hpp"
 #include "util/Incumbent.hpp"
 #include "util/func.hpp"
+#include "util/util.hpp"
+#include "util/Termination.hpp"
 
 #include "Common.hpp"
 
 #include "workstealing/Scheduler.hpp"
 #include "workstealing/policies/Workpool.hpp"
+#include "workstealing/policies/WorkerDequePool.hpp"
 #include "workstealing/policies/DepthPoolPolicy.hpp"
 
 namespace YewPar { namespace Skeletons {
@@ -56,9 +59,14 @@ struct DepthBounded {
 
   typedef typename parameter::value_type<args, API::tag::DepthBoundedPoolPolicy, Workstealing::Policies::DepthPoolPolicy>::type Policy;
 
+  // With autoSpawnDepth, tasks below the cutoff check for idle workers every
+  // splitCheckInterval nodes and spawn their remaining siblings if any are found
+  static constexpr unsigned splitCheckInterval = 1024;
+
   static void printSkeletonDetails(const API::Params<Bound> & params) {
     hpx::cout << "Skeleton Type: DepthBounded\n";
     hpx::cout << "d_cutoff: " << params.spawnDepth << "\n";
+    hpx::cout << "Auto d_cutoff: " << std::boolalpha << params.autoSpawnDepth << "\n";
     hpx::cout << "Enumeration : " << std::boolalpha << isEnumeration << "\n";
     hpx::cout << "Optimisation: " << std::boolalpha << isOptimisation << "\n";
     hpx::cout << "Decision: " << std::boolalpha << isDecision << "\n";
@@ -71,6 +79,8 @@ struct DepthBounded {
     }
     if constexpr (std::is_same<Policy, Workstealing::Policies::Workpool>::value) {
       hpx::cout << "Workpool: Deque\n";
+    } else if constexpr (std::is_same<Policy, Workstealing::Policies::WorkerDequePool>::value) {
+      hpx::cout << "Workpool: WorkerDeques\n";
     } else {
       hpx::cout << "Workpool: DepthPool\n";
     }
@@ -81,7 +91,6 @@ struct DepthBounded {
                                const Node & n,
                                const API::Params<Bound> & params,
                                Enum & acc,
-                               std::vector<hpx::future<void> > & childFutures,
                                const unsigned childDepth) {
     Generator newCands = Generator(space, n);
 
@@ -100,7 +109,7 @@ struct DepthBounded {
       //default continue
 
       // Spawn new tasks for all children (that are still alive after pruning)
-      childFutures.push_back(createTask(childDepth + 1, c));
+      createTask(childDepth + 1, c);
     }
   }
 
@@ -109,96 +118,102 @@ struct DepthBounded {
                              const API::Params<Bound> & params,
                              Enum & acc,
                              const unsigned childDepth) {
-    auto reg = Registry<Space, Node, Bound, Enum>::gReg;
-    Generator newCands = Generator(space, n);
-
-    if constexpr(isDecision) {
-        if (reg->stopSearch) {
-          return;
-        }
-      }
-
-    if constexpr(isDepthLimited) {
-        if (childDepth == params.maxDepth) {
-          return;
-        }
-    }
-
-    for (auto i = 0; i < newCands.numChildren; ++i) {
-      auto c = newCands.next();
-
-      auto pn = ProcessNode<Space, Node, Args...>::processNode(params, space, c, acc);
-      if (pn == ProcessNodeRet::Exit) { return; }
-      else if (pn == ProcessNodeRet::Prune) { continue; }
-      else if (pn == ProcessNodeRet::Break) { break; }
+    DepthFirst<Generator, Args...>::expandNoSpawns(space, n, params, acc, childDepth);
+  }
 
-      expandNoSpawns(space, c, params, acc, childDepth + 1);
-    }
+  // As expandNoSpawns but, if workers on this locality are idle, the rest of
+  // the shallowest level with work left is spawned rather than searched. The check only happens
+  // every splitCheckInterval nodes so only tasks that turn out to be large
+  // get split.
+  static void expandAdaptive(const Space & space,
+                             const Node & n,
+                             const API::Params<Bound> & params,
+                             Enum & acc,
+                             const unsigned childDepth) {
+    unsigned nodesSinceCheck = 0;
+    DepthFirst<Generator, Args...>::expand(
+        space, n, params, acc, childDepth,
+        [&]() {
+          if (++nodesSinceCheck < splitCheckInterval) {
+            return false;
+          }
+          nodesSinceCheck = 0;
+          return Workstealing::Scheduler::numIdleSchedulers.load() > 0;
+        },
+        [&](const Node & c, const unsigned depth) {
+          createTask(depth, c);
+        });
   }
 
-  static void subtreeTask(const Node taskRoot,
-                          const unsigned childDepth,
-                          const hpx::id_type donePromiseId) {
-    auto reg = Registry<Space, Node, Bound, Enum>::gReg;
+  static void subtreeTask(const Context::Id ctx,
+                          const Node taskRoot,
+                          const unsigned childDepth) {
+    Context::Scope scope(ctx);
+    auto reg = Registry<Space, Node, Bound, Enum>::get();
 
     Enum acc;
-    std::vector<hpx::future<void> > childFutures;
 
     if (childDepth <= reg->params.spawnDepth) {
-      expandWithSpawns(reg->space, taskRoot, reg->params, acc, childFutures, childDepth);
+      expandWithSpawns(reg->space, taskRoot, reg->params, acc, childDepth);
+    } else if (reg->params.autoSpawnDepth) {
+      expandAdaptive(reg->space, taskRoot, reg->params, acc, childDepth);
     } else {
       expandNoSpawns(reg->space, taskRoot, reg->params, acc, childDepth);
     }
 
-    // Atomically updates the (process) local enumerator
+    // Adds to this worker thread's (process local) enumerator
     if constexpr (isEnumeration) {
       reg->updateEnumerator(acc);
     }
 
-    termination_wait_act act;
-    hpx::post(act, hpx::find_here(), std::move(childFutures), donePromiseId);
+    // Children were all counted when they were created
+    Termination::taskCompleted();
   }
 
-  static hpx::future<void> createTask(const unsigned childDepth,
-                                      const Node & taskRoot) {
-    hpx::distributed::promise<void> prom;
-    auto pfut = prom.get_future();
-    auto pid  = prom.get_id();
+  static void createTask(const unsigned childDepth,
+                         const Node & taskRoot) {
+    Termination::taskCreated();
 
     DepthBounded_::SubtreeTask<Generator, Args...> t;
     hpx::distributed::function<void(hpx::id_type)> task;
-    task = hpx::bind(t, hpx::placeholders::_1, taskRoot, childDepth, pid);
+    task = hpx::bind(t, hpx::placeholders::_1, Context::current(), taskRoot, childDepth);
 
-    auto workPool = std::static_pointer_cast<Policy>(Workstealing::Scheduler::local_policy);
-    if constexpr (std::is_same<Policy, Workstealing::Policies::Workpool>::value) {
-      workPool->addwork(task);
-    } else {
+    auto workPool = std::static_pointer_cast<Policy>(Workstealing::Scheduler::getPolicy());
+    if constexpr (std::is_same<Policy, Workstealing::Policies::DepthPoolPolicy>::value) {
       workPool->addwork(task, childDepth - 1);
+    } else {
+      workPool->addwork(task);
     }
-
-     return pfut;
   }
 
   static auto search (const Space & space,
                       const Node & root,
-                      const API::Params<Bound> params = API::Params<Bound>()) {
+                      const API::Params<Bound> searchParams = API::Params<Bound>()) {
+    auto params = searchParams;
+    if (params.autoSpawnDepth) {
+      auto workers = util::findWorkerSlots().size();
+      auto maxSpawnDepth = params.maxDepth > 1 ? params.maxDepth - 1 : 1;
+      params.spawnDepth = estimateSpawnDepth<Generator>(space, root, workers * params.tasksPerWorker, maxSpawnDepth);
+    }
+
     if constexpr (verbose) {
         printSkeletonDetails(params);
     }
 
+    Context::SearchScope ctx;
+
     hpx::wait_all(hpx::lcos::broadcast<InitRegistryAct<Space, Node, Bound, Enum> >(
-        hpx::find_all_localities(), space, root, params));
+        hpx::find_all_localities(), ctx.id(), space, root, params));
 
     Policy::initPolicy();
 
-    auto threadCount = hpx::get_os_thread_count() == 1 ? 1 : hpx::get_os_thread_count() - 1;
-    hpx::wait_all(hpx::lcos::broadcast<Workstealing::Scheduler::startSchedulers_act>(
-        hpx::find_all_localities(), threadCount));
+    hpx::wait_all(hpx::lcos::broadcast<Workstealing::Scheduler::startLocalSchedulers_act>(
+        hpx::find_all_localities()));
 
     if constexpr(isOptimisation || isDecision) {
       auto inc = hpx::new_<Incumbent>(hpx::find_here()).get();
       hpx::wait_all(hpx::lcos::broadcast<UpdateGlobalIncumbentAct<Space, Node, Bound, Enum> >(
-          hpx::find_all_localities(), inc));
+          hpx::find_all_localities(), ctx.id(), inc));
       initIncumbent<Space, Node, Bound, Enum, Objcmp, Verbose>(root, params.initialBound);
     }
 
@@ -206,22 +221,20 @@ struct DepthBounded {
     if constexpr(isEnumeration) {
         Enum acc;
         acc.accumulate(root);
-        Registry<Space, Node, Bound, Enum>::gReg->updateEnumerator(acc);
+        Registry<Space, Node, Bound, Enum>::get()->updateEnumerator(acc);
     }
 
-    createTask(1, root).get();
+    createTask(1, root);
+    Termination::waitForTermination();
 
     hpx::wait_all(hpx::lcos::broadcast<Workstealing::Scheduler::stopSchedulers_act>(
-        hpx::find_all_localities()));
+        hpx::find_all_localities(), ctx.id()));
 
     // Return the right thing
     if constexpr(isEnumeration) {
       return combineEnumerators<Space, Node, Bound, Enum>();
     } else if constexpr(isOptimisation || isDecision) {
-      auto reg = Registry<Space, Node, Bound, Enum>::gReg;
-
-      typedef typename Incumbent::GetIncumbentAct<Node, Bound, Objcmp, Verbose> getInc;
-      return hpx::async<getInc>(reg->globalIncumbent).get();
+      return getIncumbent<Space, Node, Bound, Enum, Objcmp, Verbose>();
     } else {
       static_assert(isEnumeration || isOptimisation || isDecision, "Please provide a supported search type: Enumeration, Optimisation, Decision");
     }
@@ -244,7 +257,7 @@ namespace hpx { namespace traits {
 
 template <typename Generator, typename ...Args>
 struct action_stacksize<YewPar::Skeletons::DepthBounded_::SubtreeTask<Generator, Args...> > {
-  static constexpr threads::thread_stacksize value = threads::thread_stacksize::huge;
+  static constexpr threads::thread_stacksize value = threads::thread_stacksize::medium;
 };
 
 }}
@@ -0,0 +1,245 @@
+#ifndef SKELETONS_HYBRID_HPP
+#define SKELETONS_HYBRID_HPP
+
+#include <iostream>
+#include <vector>
+#include <cstdint>
+
+#include "API.hpp"
+
+#include <hpx/collectives/broadcast.hpp>
+#include <hpx/iostream.hpp>
+
+#include "util/NodeGenerator.hpp"
+#include "util/Registry.hpp"
+#include "util/Incumbent.hpp"
+#include "util/func.hpp"
+#include "util/Termination.hpp"
+
+#include "Common.hpp"
+
+#include "workstealing/Scheduler.hpp"
+#include "workstealing/policies/HybridPolicy.hpp"
+
+#include "skeletons/StackStealing.hpp"
+
+namespace YewPar { namespace Skeletons {
+
+namespace Hybrid_ {
+
+template <typename Generator, typename ...Args>
+struct SubtreeTask;
+
+}
+
+// DepthBounded spawning above spawnDepth, stack stealing below it. Subtree
+// tasks below the cutoff register their generator stack with the policy so
+// that, once the depth pools drain, idle workers can split long running
+// subtrees rather than waiting on a single core to finish them.
+template <typename Generator, typename ...Args>
+struct Hybrid {
+  typedef typename Generator::Nodetype Node;
+  typedef typename Generator::Spacetype Space;
+
+  typedef typename API::skeleton_signature::bind<Args...>::type args;
+
+  static constexpr bool isEnumeration = parameter::value_type<args, API::tag::Enumeration_, std::integral_constant<bool, false> >::type::value;
+  static constexpr bool isOptimisation = parameter::value_type<args, API::tag::Optimisation_, std::integral_constant<bool, false> >::type::value;
+  static constexpr bool isDecision = parameter::value_type<args, API::tag::Decision_, std::integral_constant<bool, false> >::type::value;
+  static constexpr bool isDepthLimited = parameter::value_type<args, API::tag::DepthLimited_, std::integral_constant<bool, false> >::type::value;
+  static constexpr bool pruneLevel = parameter::value_type<args, API::tag::PruneLevel_, std::integral_constant<bool, false> >::type::value;
+  static constexpr unsigned maxStackDepth = parameter::value_type<args, API::tag::MaxStackDepth, std::integral_constant<unsigned, 5000> >::type::value;
+
+  typedef typename parameter::value_type<args, API::tag::Verbose_, std::integral_constant<unsigned, 0> >::type Verbose;
+  static constexpr unsigned verbose = Verbose::value;
+
+  typedef typename parameter::value_type<args, API::tag::BoundFunction, nullFn__>::type boundFn;
+  typedef typename boundFn::return_type Bound;
+  typedef typename parameter::value_type<args, API::tag::ObjectiveComparison, std::greater<Bound> >::type Objcmp;
+  typedef typename parameter::value_type<args, API::tag::Enumerator, IdentityEnumerator<Node>>::type Enum;
+
+  static void printSkeletonDetails(const API::Params<Bound> & params) {
+    hpx::cout << "Skeleton Type: Hybrid\n";
+    hpx::cout << "d_cutoff: " << params.spawnDepth << "\n";
+    hpx::cout << "Enumeration : " << std::boolalpha << isEnumeration << "\n";
+    hpx::cout << "Optimisation: " << std::boolalpha << isOptimisation << "\n";
+    hpx::cout << "Decision: " << std::boolalpha << isDecision << "\n";
+    hpx::cout << "DepthLimited: " << std::boolalpha << isDepthLimited << "\n";
+    hpx::cout << "MaxStackDepth: " << maxStackDepth << "\n";
+    if constexpr(!std::is_same<boundFn, nullFn__>::value) {
+        hpx::cout << "Using Bounding: true\n";
+        hpx::cout << "PruneLevel Optimisation: " << std::boolalpha << pruneLevel << "\n";
+      } else {
+      hpx::cout << "Using Bounding: false\n";
+    }
+    hpx::cout << "Chunking Enabled: " << std::boolalpha << params.stealAll << "\n";
+    hpx::cout << std::flush;
+  }
+
+  // The id is unused: tasks are tracked by YewPar::Termination counting
+  static void subTreeTask(const Context::Id ctx,
+                          const Node taskRoot,
+                          const unsigned childDepth,
+                          const hpx::id_type) {
+    Context::Scope scope(ctx);
+    auto reg = Registry<Space, Node, Bound, Enum>::get();
+
+    Enum acc;
+
+    // Nodes stolen from a stack are never seen by their parent's processNode,
+    // so for consistency every task accounts for its own root
+    if constexpr(isEnumeration) {
+      acc.accumulate(taskRoot);
+    }
+
+    if (childDepth <= reg->params.spawnDepth) {
+      expandWithSpawns(reg->space, taskRoot, reg->params, acc, childDepth);
+    } else {
+      expandWithStack(reg->space, taskRoot, acc, childDepth);
+    }
+
+    // Adds to this worker thread's (process local) enumerator
+    if constexpr (isEnumeration) {
+      reg->updateEnumerator(acc);
+    }
+
+    Termination::taskCompleted();
+  }
+
+  using SubTreeTask = func<
+    decltype(&Hybrid<Generator, Args...>::subTreeTask),
+    &Hybrid<Generator, Args...>::subTreeTask>;
+
+  using Policy      = Workstealing::Policies::HybridPolicy<Node, SubTreeTask, Args...>;
+  using SharedState = typename Policy::SharedState_t;
+
+  static void expandWithSpawns(const Space & space,
+                               const Node & n,
+                               const API::Params<Bound> & params,
+                               Enum & acc,
+                               const unsigned childDepth) {
+    Generator newCands = Generator(space, n);
+
+    if constexpr(isDepthLimited) {
+        if (childDepth == params.maxDepth) {
+          return;
+        }
+    }
+
+    for (auto i = 0; i < newCands.numChildren; ++i) {
+      auto c = newCands.next();
+
+      // Enumeration children are accumulated by their own task
+      if constexpr(!isEnumeration) {
+        auto pn = ProcessNode<Space, Node, Args...>::processNode(params, space, c, acc);
+        if (pn == ProcessNodeRet::Exit) { return; }
+        else if (pn == ProcessNodeRet::Prune) { continue; }
+        else if (pn == ProcessNodeRet::Break) { break; }
+      }
+
+      createTask(childDepth + 1, c);
+    }
+  }
+
+  // Search the subtree using an explicit generator stack registered with the
+  // policy, reusing the StackStealing search loop to answer steal requests
+  static void expandWithStack(const Space & space,
+                              const Node & n,
+                              Enum & acc,
+                              const unsigned childDepth) {
+    auto reg = Registry<Space, Node, Bound, Enum>::get();
+
+    if constexpr(isDepthLimited) {
+        if (childDepth == reg->params.maxDepth) {
+          return;
+        }
+    }
+
+    auto generatorStack = GeneratorStack<Generator>::acquire(space, n);
+
+    auto policy = std::static_pointer_cast<Policy>(Workstealing::Scheduler::getPolicy());
+
+    std::shared_ptr<SharedState> stealReq;
+    unsigned threadId;
+    std::tie(stealReq, threadId) = policy->registerThread();
+
+    StackStealing<Generator, Args...>::runWithStack(childDepth, space, *generatorStack, stealReq, acc);
+
+    policy->unregisterThread(threadId);
+  }
+
+  static void createTask(const unsigned childDepth,
+                         const Node & taskRoot) {
+    Termination::taskCreated();
+
+    Hybrid_::SubtreeTask<Generator, Args...> t;
+    hpx::distributed::function<void(hpx::id_type)> task;
+    task = hpx::bind(t, hpx::placeholders::_1, Context::current(), taskRoot, childDepth, hpx::invalid_id);
+
+    std::static_pointer_cast<Policy>(Workstealing::Scheduler::getPolicy())->addwork(task, childDepth - 1);
+  }
+
+  static auto search (const Space & space,
+                      const Node & root,
+                      const API::Params<Bound> params = API::Params<Bound>()) {
+    if constexpr (verbose) {
+        printSkeletonDetails(params);
+    }
+
+    Context::SearchScope ctx;
+
+    hpx::wait_all(hpx::lcos::broadcast<InitRegistryAct<Space, Node, Bound, Enum> >(
+        hpx::find_all_localities(), ctx.id(), space, root, params));
+
+    Policy::initPolicy();
+
+    hpx::wait_all(hpx::lcos::broadcast<Workstealing::Scheduler::startLocalSchedulers_act>(
+        hpx::find_all_localities()));
+
+    if constexpr(isOptimisation || isDecision) {
+      auto inc = hpx::new_<Incumbent>(hpx::find_here()).get();
+      hpx::wait_all(hpx::lcos::broadcast<UpdateGlobalIncumbentAct<Space, Node, Bound, Enum> >(
+          hpx::find_all_localities(), ctx.id(), inc));
+      initIncumbent<Space, Node, Bound, Enum, Objcmp, Verbose>(root, params.initialBound);
+    }
+
+    // The root task accumulates the root node for enumeration
+    createTask(1, root);
+    Termination::waitForTermination();
+
+    hpx::wait_all(hpx::lcos::broadcast<Workstealing::Scheduler::stopSchedulers_act>(
+        hpx::find_all_localities(), ctx.id()));
+
+    // Return the right thing
+    if constexpr(isEnumeration) {
+      return combineEnumerators<Space, Node, Bound, Enum>();
+    } else if constexpr(isOptimisation || isDecision) {
+      return getIncumbent<Space, Node, Bound, Enum, Objcmp, Verbose>();
+    } else {
+      static_assert(isEnumeration || isOptimisation || isDecision, "Please provide a supported search type: Enumeration, Optimisation, Decision");
+    }
+  }
+};
+
+namespace Hybrid_ {
+
+template <typename Generator, typename ...Args>
+struct SubtreeTask : hpx::actions::make_action<
+  decltype(&Hybrid<Generator, Args...>::subTreeTask),
+  &Hybrid<Generator, Args...>::subTreeTask,
+  SubtreeTask<Generator, Args...>>::type {};
+
+}
+
+}}
+
+namespace hpx { namespace traits {
+
+template <typename Generator, typename ...Args>
+struct action_stacksize<YewPar::Skeletons::Hybrid_::SubtreeTask<Generator, Args...> > {
+  static constexpr threads::thread_stacksize value = threads::thread_stacksize::medium;
+};
+
+}}
+
+#endif
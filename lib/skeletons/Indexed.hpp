@@ -0,0 +1,464 @@
+#ifndef SKELETONS_INDEXED_HPP
+#define SKELETONS_INDEXED_HPP
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <vector>
+#include <cstdint>
+
+#include "API.hpp"
+
+#include <hpx/collectives/broadcast.hpp>
+#include <hpx/iostream.hpp>
+#include <hpx/serialization/vector.hpp>
+
+#include <boost/format.hpp>
+
+#include "util/NodeGenerator.hpp"
+#include "util/Registry.hpp"
+#include "util/Incumbent.hpp"
+#include "util/func.hpp"
+#include "util/util.hpp"
+#include "util/Termination.hpp"
+
+#include "Common.hpp"
+
+#include "workstealing/Scheduler.hpp"
+#include "workstealing/policies/SearchManager.hpp"
+
+namespace YewPar { namespace Skeletons {
+
+// Recompute based stack stealing. Rather than sending the stolen node to the
+// thief we send the path (child indices) from the root to that node and the
+// thief rebuilds it locally using Generator::nth. This keeps steals small for
+// problems with large nodes at the cost of some recomputation on the thief.
+template <typename Generator, typename ...Args>
+struct Indexed {
+  typedef typename Generator::Nodetype Node;
+  typedef typename Generator::Spacetype Space;
+
+  typedef typename API::skeleton_signature::bind<Args...>::type args;
+
+  static constexpr bool isEnumeration = parameter::value_type<args, API::tag::Enumeration_, std::integral_constant<bool, false> >::type::value;
+  static constexpr bool isOptimisation = parameter::value_type<args, API::tag::Optimisation_, std::integral_constant<bool, false> >::type::value;
+  static constexpr bool isDecision = parameter::value_type<args, API::tag::Decision_, std::integral_constant<bool, false> >::type::value;
+  static constexpr bool isDepthBounded = parameter::value_type<args, API::tag::DepthLimited_, std::integral_constant<bool, false> >::type::value;
+  static constexpr bool pruneLevel = parameter::value_type<args, API::tag::PruneLevel_, std::integral_constant<bool, false> >::type::value;
+  static constexpr unsigned maxStackDepth = parameter::value_type<args, API::tag::MaxStackDepth, std::integral_constant<unsigned, 5000> >::type::value;
+
+  typedef typename parameter::value_type<args, API::tag::Verbose_, std::integral_constant<unsigned, 0> >::type Verbose;
+  static constexpr unsigned verbose = Verbose::value;
+
+  typedef typename parameter::value_type<args, API::tag::BoundFunction, nullFn__>::type boundFn;
+  typedef typename boundFn::return_type Bound;
+  typedef typename parameter::value_type<args, API::tag::ObjectiveComparison, std::greater<Bound> >::type Objcmp;
+  typedef typename parameter::value_type<args, API::tag::Enumerator, IdentityEnumerator<Node>>::type Enum;
+
+  // Child indices from the root to a node
+  using Path = std::vector<unsigned>;
+
+  static void printSkeletonDetails(const API::Params<Bound> & params) {
+    hpx::cout << "Skeleton Type: Indexed\n";
+    hpx::cout << "Enumeration : " << std::boolalpha << isEnumeration << "\n";
+    hpx::cout << "Optimisation: " << std::boolalpha << isOptimisation << "\n";
+    hpx::cout << "Decision: " << std::boolalpha << isDecision << "\n";
+    hpx::cout << "DepthBounded: " << std::boolalpha << isDepthBounded << "\n";
+    hpx::cout << "MaxStackDepth: " << maxStackDepth << "\n";
+    if constexpr(!std::is_same<boundFn, nullFn__>::value) {
+        hpx::cout << "Using Bounding: true\n";
+        hpx::cout << "PruneLevel Optimisation: " << std::boolalpha << pruneLevel << "\n";
+    } else {
+      hpx::cout << "Using Bounding: false\n";
+    }
+    hpx::cout << "Chunking Enabled: " << std::boolalpha << params.stealAll << "\n";
+    hpx::cout << std::flush;
+  }
+
+  // Rebuild a node by following a path from the root
+  static Node nodeFromPath(const Space & space, const Node & root, const Path & path) {
+    Node n = root;
+    for (const auto & idx : path) {
+      // Generators may hold references to their parent so the child must be
+      // fully built before we overwrite n
+      Generator gen(space, n);
+      auto child = gen.nth(idx);
+      n = std::move(child);
+    }
+    return n;
+  }
+
+  // Path of the idx'th child at stack level "level"
+  static Path pathAt(const Path & taskPath,
+                     const GeneratorStack<Generator> & generatorStack,
+                     const int level,
+                     const unsigned idx) {
+    Path p(taskPath);
+    p.reserve(taskPath.size() + level + 1);
+    // Not seen - 1: children stolen from a level after we descended from it
+    // also move seen on
+    for (auto i = 0; i < level; ++i) {
+      p.push_back(generatorStack[i].current);
+    }
+    p.push_back(idx);
+    return p;
+  }
+
+  // The id is unused: tasks are tracked by YewPar::Termination counting
+  static void subTreeTask(const Context::Id ctx,
+                          const Path path,
+                          const unsigned depth,
+                          const hpx::id_type) {
+    Context::Scope scope(ctx);
+    auto reg = Registry<Space, Node, Bound, Enum>::get();
+    Enum acc;
+
+    auto initNode = nodeFromPath(reg->space, reg->root, path);
+
+    // Setup the stack with the recomputed node
+    auto generatorStack = GeneratorStack<Generator>::acquire(reg->space, initNode);
+
+    if constexpr(isEnumeration) {
+        acc.accumulate(initNode);
+    }
+
+    // Register with the Policy to allow stealing from this stack
+    std::shared_ptr<SharedState> stealReq;
+    unsigned threadId;
+    std::tie(stealReq, threadId) = std::static_pointer_cast<Policy>(Workstealing::Scheduler::getPolicy())->registerThread();
+
+    runTaskFromStack(depth, path, reg->space, *generatorStack, stealReq, acc, threadId);
+  }
+
+  using SubTreeTask = func<
+    decltype(&Indexed<Generator, Args...>::subTreeTask),
+    &Indexed<Generator, Args...>::subTreeTask>;
+
+  using Policy      = Workstealing::Policies::SearchManager::SearchManagerComp<Path, SubTreeTask, Args...>;
+  using Response    = typename Policy::Response_t;
+  using SharedState = typename Policy::SharedState_t;
+
+  static void runWithStack(const int startingDepth,
+                           const Path & taskPath,
+                           const Space & space,
+                           GeneratorStack<Generator> & generatorStack,
+                           std::shared_ptr<SharedState> stealRequest,
+                           Enum & acc,
+                           int stackDepth = 0,
+                           int depth = -1) {
+    auto reg = Registry<Space, Node, Bound, Enum>::get();
+
+    // We do this because arguments can't default initialise to themselves
+    if (depth == -1) {
+      depth = startingDepth;
+    }
+
+    while (stackDepth >= 0) {
+
+      if constexpr(isDecision) {
+        if (reg->stopSearch) {
+          return;
+        }
+      }
+
+      // Handle steals first
+      if (std::get<0>(*stealRequest)) {
+        // We steal from the highest possible generator with work
+        bool responded = false;
+        for (auto i = 0; i < stackDepth; ++i) {
+          // Work left at this level:
+          if (generatorStack[i].seen < generatorStack[i].gen.numChildren) {
+            Response res;
+            do {
+              // Counted before this task can complete
+              Termination::taskCreated();
+
+              res.emplace_back(hpx::make_tuple(pathAt(taskPath, generatorStack, i, generatorStack[i].seen),
+                                               startingDepth + i + 1, hpx::invalid_id));
+
+              // Generators are stateful so we still need to step past the
+              // stolen child even though the thief rebuilds it
+              generatorStack[i].gen.next();
+              generatorStack[i].seen++;
+            } while (reg->params.stealAll && generatorStack[i].seen < generatorStack[i].gen.numChildren);
+
+            std::get<1>(*stealRequest).set(res);
+            responded = true;
+            break;
+          }
+        }
+        if (!responded) {
+          Response res;
+          std::get<1>(*stealRequest).set(res);
+        }
+        std::get<0>(*stealRequest).store(false);
+      }
+
+      // If there's still children at this stackDepth we move into them
+      if (generatorStack[stackDepth].seen < generatorStack[stackDepth].gen.numChildren) {
+
+        // Get the next child at this stackDepth
+        auto child = generatorStack[stackDepth].gen.next();
+
+        generatorStack[stackDepth].seen++;
+
+        auto pn = ProcessNode<Space, Node, Args...>::processNode(reg->params, space, child, acc);
+        if (pn == ProcessNodeRet::Exit) { return; }
+        else if (pn == ProcessNodeRet::Prune) { continue; }
+        else if (pn == ProcessNodeRet::Break) {
+          stackDepth--;
+          depth--;
+          continue;
+        }
+
+        if constexpr(isDepthBounded) {
+          if (depth + 1 == reg->params.maxDepth) {
+            continue;
+          }
+        }
+
+        // Going down, building the child's generator in place
+        generatorStack[stackDepth].current = generatorStack[stackDepth].seen - 1;
+        stackDepth++;
+        depth++;
+        generatorStack.place(stackDepth, space, std::move(child));
+      } else {
+        stackDepth--;
+        depth--;
+      }
+    }
+  }
+
+  static void runTaskFromStack (const unsigned startingDepth,
+                                const Path & taskPath,
+                                const Space & space,
+                                GeneratorStack<Generator> & generatorStack,
+                                const std::shared_ptr<SharedState> stealRequest,
+                                Enum & acc,
+                                const unsigned searchManagerId) {
+    auto reg = Registry<Space, Node, Bound, Enum>::get();
+
+    runWithStack(startingDepth, taskPath, space, generatorStack, stealRequest, acc);
+
+    // Adds to this worker thread's (process local) counter
+    if constexpr(isEnumeration) {
+        reg->updateEnumerator(acc);
+    }
+
+    std::static_pointer_cast<Policy>(Workstealing::Scheduler::getPolicy())->unregisterThread(searchManagerId);
+
+    // Anything stolen from us was counted when it was handed out
+    Termination::taskCompleted();
+  }
+
+  // Run a batch of initial tasks one after the other. Other threads can
+  // steal from whichever task is currently running. The tasks are counted as
+  // created by the master before the batch is sent.
+  static void runInitialTasks(const std::vector<Path> taskPaths,
+                              const unsigned depth) {
+    for (const auto & p : taskPaths) {
+      subTreeTask(Context::current(), p, depth, hpx::invalid_id);
+    }
+  }
+
+  // Action to hand a batch of initial tasks to a scheduler on a distributed
+  // node (for setting initial work distribution)
+  static void addWork (const Context::Id ctx,
+                       const std::vector<Path> taskPaths,
+                       const unsigned depth) {
+    Context::Scope scope(ctx);
+    hpx::function<void(),false> fn = hpx::bind(&runInitialTasks, taskPaths, depth);
+    Workstealing::Scheduler::addTask(std::move(fn));
+  }
+  struct addWorkAct : hpx::actions::make_action<
+    decltype(&Indexed<Generator, Args...>::addWork),
+    &Indexed<Generator, Args...>::addWork,
+    addWorkAct>::type {};
+
+  // A node at the initial work frontier and its path from the root
+  struct FrontierNode {
+    Node node;
+    Path path;
+  };
+
+  // As StackStealing::findInitialWork: expand the tree breadth first until
+  // there are at least totalThreads nodes at the frontier (or the tree/depth
+  // limit runs out), keeping each frontier node's path. Returns the depth of
+  // the frontier nodes, or 0 if the search finished early (decision problems).
+  static unsigned findInitialWork(const Space & space,
+                                  const Node & root,
+                                  const API::Params<Bound> & params,
+                                  const unsigned totalThreads,
+                                  Enum & acc,
+                                  std::vector<FrontierNode> & frontier) {
+    frontier.clear();
+    frontier.push_back(FrontierNode{root, Path()});
+
+    auto depth = 1;
+    while (frontier.size() < totalThreads) {
+      // runWithStack never expands nodes at maxDepth so neither can a task root
+      if constexpr(isDepthBounded) {
+        if (depth + 1 >= params.maxDepth) {
+          break;
+        }
+      }
+
+      std::vector<FrontierNode> nextLevel;
+      for (const auto & f : frontier) {
+        if constexpr(isEnumeration) {
+          acc.accumulate(f.node);
+        }
+
+        auto newCands = Generator(space, f.node);
+        for (auto i = 0; i < newCands.numChildren; ++i) {
+          auto c = newCands.next();
+
+          // Enumeration nodes are only counted once expanded (or by their task)
+          if constexpr(!isEnumeration) {
+            auto pn = ProcessNode<Space, Node, Args...>::processNode(params, space, c, acc);
+            if (pn == ProcessNodeRet::Exit) { return 0; }
+            else if (pn == ProcessNodeRet::Prune) { continue; }
+            else if (pn == ProcessNodeRet::Break) { break; }
+          }
+
+          Path p(f.path);
+          p.push_back(i);
+          nextLevel.push_back(FrontierNode{std::move(c), std::move(p)});
+        }
+      }
+
+      frontier = std::move(nextLevel);
+      ++depth;
+
+      if (frontier.empty()) {
+        break;
+      }
+    }
+
+    return depth;
+  }
+
+  // Split the frontier into one batch of paths per worker thread (slot), each
+  // batch run by a scheduler on the slot's locality. Nodes are handed out
+  // largest estimated subtree first to the least loaded batch.
+  static void spawnInitialWork(const std::vector<FrontierNode> & frontier,
+                               const unsigned depth,
+                               const API::Params<Bound> & params,
+                               const std::vector<hpx::id_type> & slots) {
+    const auto & space = Registry<Space, Node, Bound, Enum>::get()->space;
+    const unsigned probeDepth = isDepthBounded ? params.maxDepth - depth : params.maxDepth;
+
+    std::vector<std::pair<double, unsigned> > sizes;
+    for (auto i = 0; i < frontier.size(); ++i) {
+      sizes.emplace_back(estimateSubtreeSize<Generator>(space, frontier[i].node, probeDepth), i);
+    }
+    std::sort(sizes.begin(), sizes.end(), std::greater<std::pair<double, unsigned> >());
+
+    std::vector<std::vector<Path> > batches(std::min(slots.size(), frontier.size()));
+    std::vector<double> loads(batches.size(), 0);
+    for (const auto & s : sizes) {
+      auto b = std::distance(loads.begin(), std::min_element(loads.begin(), loads.end()));
+      batches[b].push_back(frontier[s.second].path);
+      loads[b] += s.first;
+    }
+
+    Termination::taskCreated(frontier.size());
+
+    for (auto i = 0; i < batches.size(); ++i) {
+      auto loc = slots[i];
+      if (loc == hpx::find_here()) {
+        addWork(Context::current(), std::move(batches[i]), depth);
+      } else {
+        hpx::post<addWorkAct>(loc, Context::current(), std::move(batches[i]), depth);
+      }
+    }
+  }
+
+  static void doSearch(const Space & space,
+                       const Node & root,
+                       const API::Params<Bound> & params) {
+
+    // Localities may have different numbers of workers
+    auto slots = util::findWorkerSlots();
+    unsigned totalThreads = slots.size();
+
+    if (totalThreads == 1) {
+      // Master stack, rooted at the search root so it has an empty path
+      auto genStack = GeneratorStack<Generator>::acquire(space, root);
+
+      Enum acc;
+      acc.accumulate(root);
+
+      auto searchMgrInfo = std::static_pointer_cast<Policy>(Workstealing::Scheduler::getPolicy())->registerThread();
+
+      Termination::taskCreated();
+      runTaskFromStack(1, Path(), space, *genStack, std::get<0>(searchMgrInfo), acc, std::get<1>(searchMgrInfo));
+    } else {
+      Enum acc;
+      std::vector<FrontierNode> frontier;
+      auto depth = findInitialWork(space, root, params, totalThreads, acc, frontier);
+
+      if constexpr(isEnumeration) {
+        Registry<Space, Node, Bound, Enum>::get()->updateEnumerator(acc);
+      }
+
+      if (depth > 0) {
+        spawnInitialWork(frontier, depth, params, slots);
+      }
+    }
+
+    Termination::waitForTermination();
+  }
+
+  static auto search (const Space & space,
+                      const Node & root,
+                      const API::Params<Bound> params = API::Params<Bound>()) {
+    if constexpr(verbose) {
+      printSkeletonDetails(params);
+    }
+
+    Context::SearchScope ctx;
+
+    hpx::wait_all(hpx::lcos::broadcast<InitRegistryAct<Space, Node, Bound, Enum> >(
+        hpx::find_all_localities(), ctx.id(), space, root, params));
+
+    Policy::initPolicy();
+
+    hpx::wait_all(hpx::lcos::broadcast<Workstealing::Scheduler::startLocalSchedulers_act>(
+        hpx::find_all_localities()));
+
+    if constexpr(isOptimisation || isDecision) {
+      auto inc = hpx::new_<Incumbent>(hpx::find_here()).get();
+      hpx::wait_all(hpx::lcos::broadcast<UpdateGlobalIncumbentAct<Space, Node, Bound, Enum> >(
+          hpx::find_all_localities(), ctx.id(), inc));
+      initIncumbent<Space, Node, Bound, Enum, Objcmp, Verbose>(root, params.initialBound);
+    }
+
+    doSearch(space, root, params);
+
+    hpx::wait_all(hpx::lcos::broadcast<Workstealing::Scheduler::stopSchedulers_act>(
+        hpx::find_all_localities(), ctx.id()));
+
+    hpx::cout << std::flush;
+
+    if (verbose >= 3) {
+      for (const auto &l : hpx::find_all_localities()) {
+        // We don't broadcast here to avoid racy output.
+        hpx::async<Workstealing::Policies::SearchManagerPerf::printChunkSizeList_act>(l).get();
+      }
+    }
+
+    // Return the right thing
+    if constexpr(isEnumeration) {
+      return combineEnumerators<Space, Node, Bound, Enum>();
+    } else if constexpr(isOptimisation || isDecision) {
+      return getIncumbent<Space, Node, Bound, Enum, Objcmp, Verbose>();
+    } else {
+      static_assert(isEnumeration || isOptimisation || isDecision, "Please provide a supported search type: Enumeration, Optimisation, Decision");
+    }
+  }
+};
+
+}}
+
+#endif
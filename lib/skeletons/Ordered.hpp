@@ -17,7 +17,7 @@
 #include "util/Incumbent.hpp"
 #include "util/Enumerator.hpp"
 #include "util/func.hpp"
-#include "util/DistSetOnceFlag.hpp"
+#include "util/util.hpp"
 
 #include "Common.hpp"
 
@@ -68,20 +68,18 @@ struct Ordered {
   }
 
   struct OrderedTask {
-    OrderedTask(const Node n, unsigned priority) : node(n), priority(priority) {
-      startedFlag = hpx::new_<YewPar::util::DistSetOnceFlag>(hpx::find_here()).get();
-    };
+    OrderedTask(const Node n, unsigned priority) : node(n), priority(priority) {};
     const Node node;
     unsigned priority;
-    hpx::id_type startedFlag;
   };
 
   // Spawn tasks in a discrepancy search fashion
   // Discrepancy search priority based on number of discrepancies taken
-  // Invariant: spawnDepth > 0
+  // Nodes above spawnDepth are accumulated into acc when enumerating
   static std::vector<OrderedTask> prioritiseTasks(const Space & space,
                                                   unsigned spawnDepth,
-                                                  const Node & root) {
+                                                  const Node & root,
+                                                  Enum & acc) {
     std::vector<OrderedTask> tasks;
     if constexpr (discrepancySearch) {
       std::function<void(unsigned, unsigned, const Node &)>
@@ -89,6 +87,9 @@ struct Ordered {
         if (depth == 0) {
           tasks.emplace_back(OrderedTask(n, numDisc));
         } else {
+          if constexpr(isEnumeration) {
+            acc.accumulate(n);
+          }
           auto newCands = Generator(space, n);
           for (auto i = 0; i < newCands.numChildren; ++i) {
             auto node = newCands.next();
@@ -104,6 +105,9 @@ struct Ordered {
         if (depth == 0) {
           tasks.emplace_back(OrderedTask(n, 0));
         } else {
+          if constexpr(isEnumeration) {
+            acc.accumulate(n);
+          }
           auto newCands = Generator(space, n);
           for (auto i = 0; i < newCands.numChildren; ++i) {
             auto node = newCands.next();
@@ -127,66 +131,119 @@ struct Ordered {
 
     return tasks;
   }
-  static void expandNoSpawns(const Space & space,
-                             const Node & n,
-                             const API::Params<Bound> & params,
-                             Enum & acc,
-                             const unsigned childDepth) {
-    auto reg = Registry<Space, Node, Bound, Enum>::gReg;
-    Generator newCands = Generator(space, n);
 
-    if constexpr(isDecision) {
-        if (reg->stopSearch) {
-          return;
-        }
+  // Run a task to completion. The task root is counted as part of the task so
+  // that enumeration results can be combined in task order at the end.
+  static void runTask(const Space & space,
+                      const Node & taskRoot,
+                      const unsigned taskIdx,
+                      const API::Params<Bound> & params,
+                      const hpx::id_type owner) {
+    Enum acc;
+    if constexpr(isEnumeration) {
+      acc.accumulate(taskRoot);
+    }
+
+    expandNoSpawns(space, taskRoot, params, acc, params.spawnDepth + 1);
+
+    if constexpr(isEnumeration) {
+      if (owner == hpx::find_here()) {
+        Registry<Space, Node, Bound, Enum>::get()->setTaskResult(taskIdx, acc.get());
+      } else {
+        hpx::async<SetTaskResultAct<Space, Node, Bound, Enum> >(owner, Context::current(), taskIdx, acc.get()).get();
       }
+    }
+  }
 
-    if constexpr(isDepthBounded) {
-        if (childDepth == params.maxDepth) {
-          return;
-        }
+  // Claim a task on the spawning locality. Local claims are a single atomic.
+  // Remote claims learn the flags of the neighbouring tasks too, so a remote
+  // worker skips tasks it knows were started without another round trip.
+  static bool claimTask(const unsigned taskIdx, const hpx::id_type owner) {
+    auto reg = Registry<Space, Node, Bound, Enum>::get();
+    if (owner == hpx::find_here()) {
+      return reg->claimTask(taskIdx);
     }
 
-    for (auto i = 0; i < newCands.numChildren; ++i) {
-      auto c = newCands.next();
+    if (reg->startedFlags.isSet(taskIdx)) {
+      return false;
+    }
 
-      auto pn = ProcessNode<Space, Node, Args...>::processNode(params, space, c, acc);
-      if (pn == ProcessNodeRet::Exit) { return; }
-      else if (pn == ProcessNodeRet::Prune) { continue; }
-      else if (pn == ProcessNodeRet::Break) { break; }
+    const auto bit = util::TaskFlags::bit(taskIdx);
+    auto word = hpx::async<ClaimTaskFlagAct<Space, Node, Bound, Enum> >(owner, Context::current(), taskIdx).get();
+    reg->startedFlags.merge(taskIdx, word | bit);
+    return !(word & bit);
+  }
 
-      expandNoSpawns(space, c, params, acc, childDepth + 1);
-    }
+  static void expandNoSpawns(const Space & space,
+                             const Node & n,
+                             const API::Params<Bound> & params,
+                             Enum & acc,
+                             const unsigned childDepth) {
+    DepthFirst<Generator, Args...>::expandNoSpawns(space, n, params, acc, childDepth);
   }
 
   static auto search (const Space & space,
                       const Node & root,
                       const API::Params<Bound> params = API::Params<Bound>()) {
+    static_assert(isEnumeration || isOptimisation || isDecision, "Please provide a supported search type: Enumeration, Optimisation, Decision");
+
     if constexpr(verbose) {
       printSkeletonDetails();
     }
 
+    Context::SearchScope ctx;
+
     hpx::wait_all(hpx::lcos::broadcast<InitRegistryAct<Space, Node, Bound, Enum> >(
-        hpx::find_all_localities(), space, root, params));
+        hpx::find_all_localities(), ctx.id(), space, root, params));
 
     if constexpr(isOptimisation || isDecision) {
       auto inc = hpx::new_<Incumbent>(hpx::find_here()).get();
       hpx::wait_all(hpx::lcos::broadcast<UpdateGlobalIncumbentAct<Space, Node, Bound, Enum> >(
-          hpx::find_all_localities(), inc));
+          hpx::find_all_localities(), ctx.id(), inc));
       initIncumbent<Space, Node, Bound, Enum, Objcmp, Verbose>(root, params.initialBound);
     }
 
     Workstealing::Policies::PriorityOrderedPolicy::initPolicy();
 
+    // Tasks are fixed up front to keep the search order replicable, so unlike
+    // DepthBounded we only choose the depth and never split tasks at runtime
+    auto spawnDepth = params.spawnDepth;
+    if (params.autoSpawnDepth) {
+      auto workers = util::findWorkerSlots().size();
+      auto maxSpawnDepth = params.maxDepth > 1 ? params.maxDepth - 1 : 1;
+      spawnDepth = estimateSpawnDepth<Generator>(space, root, workers * params.tasksPerWorker, maxSpawnDepth);
+      if (verbose > 1) {
+        hpx::cout << (boost::format("Ordered Skeleton chose spawn depth %1%\n") % spawnDepth) << std::flush;
+      }
+    }
+
+    // Tasks can't be spawned below the depth limit
+    if constexpr(isDepthBounded) {
+      if (params.maxDepth > 0 && spawnDepth >= params.maxDepth) {
+        spawnDepth = params.maxDepth - 1;
+      }
+    }
+
+    auto reg = Registry<Space, Node, Bound, Enum>::get();
+    reg->params.spawnDepth = spawnDepth;
+
     auto spawn_start_time = std::chrono::steady_clock::now();
     // Spawn all tasks to some depth *ordered*
-    auto tasks = prioritiseTasks(space, params.spawnDepth, root);
-    for (auto const & t : tasks) {
+    Enum spawnAcc;
+    auto tasks = prioritiseTasks(space, spawnDepth, root, spawnAcc);
+    // Every locality keeps flags, only ours are authoritative
+    hpx::wait_all(hpx::lcos::broadcast<InitTaskFlagsAct<Space, Node, Bound, Enum> >(
+        hpx::find_all_localities(), ctx.id(), tasks.size()));
+    reg->initTasks(tasks.size());
+
+    // Tasks refer to their start flag by their position in the spawn order
+    auto here = hpx::find_here();
+    for (auto i = 0; i < tasks.size(); ++i) {
       Ordered_::SubtreeTask<Generator, Args...> child;
       hpx::distributed::function<void(hpx::id_type)> task;
-      task = hpx::bind(child, hpx::placeholders::_1, t.node, t.startedFlag);
+      task = hpx::bind(child, hpx::placeholders::_1, ctx.id(), tasks[i].node, static_cast<unsigned>(i), spawnDepth, here);
       std::static_pointer_cast<Workstealing::Policies::PriorityOrderedPolicy>
-          (Workstealing::Scheduler::local_policy)->addwork(t.priority, std::move(task));
+          (Workstealing::Scheduler::getPolicy())->addwork(tasks[i].priority, std::move(task));
     }
 
     if (verbose > 1) {
@@ -201,19 +258,20 @@ struct Ordered {
     // else to handle the sequential order
     auto allLocs = hpx::find_all_localities();
 
-    if (!allLocs.size() > 1) {
+    if (allLocs.size() > 1) {
       // Start schedulers everywhere but here
       allLocs.erase(std::remove(allLocs.begin(), allLocs.end(), hpx::find_here()), allLocs.end());
-      auto threadCount = hpx::get_os_thread_count() == 1 ? 1 : hpx::get_os_thread_count() - 1;
-      hpx::wait_all(hpx::lcos::broadcast<Workstealing::Scheduler::startSchedulers_act>(allLocs, threadCount));
+      hpx::wait_all(hpx::lcos::broadcast<Workstealing::Scheduler::startLocalSchedulers_act>(allLocs));
     }
 
     auto threadCountLocal = hpx::get_os_thread_count() <= 2 ? 0 : hpx::get_os_thread_count() - 2;
     Workstealing::Scheduler::startSchedulers(threadCountLocal);
 
     // Make this thread the sequential thread of execution.
-    auto reg = Registry<Space, Node, Bound, Enum>::gReg;
-    for (auto & t : tasks) {
+    auto seqParams = reg->params;
+    for (auto i = 0; i < tasks.size(); ++i) {
+      const auto & t = tasks[i];
+
       // Allow early termination of sequential thread
       if constexpr(isDecision) {
         if (reg->stopSearch) {
@@ -221,6 +279,11 @@ struct Ordered {
         }
       }
 
+      // Someone else already has this task, skip without touching the flag
+      if (reg->startedFlags.isSet(i)) {
+        continue;
+      }
+
       // Quick prune path to avoid writing global flags
       if constexpr(isOptimisation && !std::is_same<boundFn, nullFn__>::value) {
         Objcmp cmp;
@@ -231,32 +294,38 @@ struct Ordered {
         }
       }
 
-      auto weStarted = hpx::async<YewPar::util::DistSetOnceFlag::set_value_action>(t.startedFlag).get();
-      if (weStarted) {
-        Enum acc;
-        expandNoSpawns(space, t.node, params, acc, params.spawnDepth);
+      if (reg->claimTask(i)) {
+        runTask(space, t.node, i, seqParams, here);
       }
     }
 
     // We have either seen everything or terminated early to make sure everyone stops
     hpx::wait_all(hpx::lcos::broadcast<Workstealing::Scheduler::stopSchedulers_act>(
-        hpx::find_all_localities()));
+        hpx::find_all_localities(), ctx.id()));
 
     // Return the right thing
-    if constexpr(isOptimisation || isDecision) {
-      auto reg = Registry<Space, Node, Bound, Enum>::gReg;
-      typedef typename Incumbent::GetIncumbentAct<Node, Bound, Objcmp, Verbose> getInc;
-      return hpx::async<getInc>(reg->globalIncumbent).get();
+    if constexpr(isEnumeration) {
+      // Combine in task order so the result does not depend on who ran what
+      Enum res;
+      res.combine(spawnAcc.get());
+      for (const auto & r : reg->taskResults) {
+        res.combine(r);
+      }
+      return res.get();
     } else {
-      static_assert(isEnumeration, "Please provide a supported search type: Enumeration, Optimisation, Decision");
-      static_assert(isOptimisation || isDecision, "Please provide a supported search type: Enumeration, Optimisation, Decision");
+      return getIncumbent<Space, Node, Bound, Enum, Objcmp, Verbose>();
     }
   }
 
-  static void subtreeTask(const Node taskRoot,
-                          const hpx::id_type started) {
+  static void subtreeTask(const Context::Id ctx,
+                          const Node taskRoot,
+                          const unsigned taskIdx,
+                          const unsigned spawnDepth,
+                          const hpx::id_type owner) {
+    Context::Scope scope(ctx);
+
     // Don't bother checking if the sequential thread has done this task since we are stopping anyway
-    auto reg = Registry<Space, Node, Bound, Enum>::gReg;
+    auto reg = Registry<Space, Node, Bound, Enum>::get();
     if constexpr (isDecision) {
       if (reg->stopSearch) {
         return;
@@ -273,11 +342,11 @@ struct Ordered {
       }
     }
 
-    auto weStarted = hpx::async<YewPar::util::DistSetOnceFlag::set_value_action>(started).get();
     // Sequential thread has beaten us to this task. Don't bother executing it again.
-    if (weStarted) {
-      Enum acc;
-      expandNoSpawns(reg->space, taskRoot, reg->params, acc, reg->params.spawnDepth);
+    if (claimTask(taskIdx, owner)) {
+      auto params = reg->params;
+      params.spawnDepth = spawnDepth;
+      runTask(reg->space, taskRoot, taskIdx, params, owner);
     }
   }
 };
@@ -296,7 +365,7 @@ namespace hpx { namespace traits {
 
 template <typename Generator, typename ...Args>
 struct action_stacksize<YewPar::Skeletons::Ordered_::SubtreeTask<Generator, Args...> > {
-  static constexpr threads::thread_stacksize value = threads::thread_stacksize::huge;
+  static constexpr threads::thread_stacksize value = threads::thread_stacksize::medium;
 };
 
 }}
@@ -3,6 +3,7 @@
 
 #include <hpx/iostream.hpp>
 #include <vector>
+#include <deque>
 #include <cstdint>
 
 #include <boost/format.hpp>
@@ -47,14 +48,26 @@ struct Seq {
     hpx::cout << std::flush;
   }
 
+  // A node being expanded along with how many of its children we have seen.
+  // Levels are kept in a deque so pushing never moves the nodes generators
+  // may refer to.
+  struct Level {
+    Node node;
+    Generator gen;
+    unsigned seen;
+
+    Level(const Space & space, const Node & n) : node(n), gen(Generator(space, node)), seen(0) {};
+  };
+
+  // Depth first search using an explicit stack of generators, so deep trees
+  // don't overflow the (thread) stack. Returns true if a decision problem
+  // found its target.
   static bool expand(const Space & space,
                      const Node & n,
                      const API::Params<Bound> & params,
                      std::pair<Node, Bound> & incumbent,
                      const unsigned childDepth,
                      Enumerator & acc) {
-    Generator newCands = Generator(space, n);
-
     if constexpr(isEnumeration) {
         acc.accumulate(n);
     }
@@ -65,8 +78,22 @@ struct Seq {
         }
       }
 
-    for (auto i = 0; i < newCands.numChildren; ++i) {
-      auto c = newCands.next();
+    std::deque<Level> stack;
+    stack.emplace_back(space, n);
+
+    // The depth of the children of the top level
+    auto depth = childDepth;
+
+    while (!stack.empty()) {
+      auto & top = stack.back();
+      if (top.seen == top.gen.numChildren) {
+        stack.pop_back();
+        --depth;
+        continue;
+      }
+
+      auto c = top.gen.next();
+      ++top.seen;
 
       if constexpr(isDecision) {
         if (c.getObj() == params.expectedObjective) {
@@ -85,25 +112,21 @@ struct Seq {
       if constexpr(!std::is_same<boundFn, nullFn__>::value) {
           Objcmp cmp;
           auto bnd  = boundFn::invoke(space, c);
+          bool prune;
           if constexpr(isDecision) {
-            if (!cmp(bnd, params.expectedObjective) && bnd != params.expectedObjective) {
-              if constexpr(pruneLevel) {
-                break;
-              } else {
-                continue;
-              }
-            }
+            prune = !cmp(bnd, params.expectedObjective) && bnd != params.expectedObjective;
           // B&B Case
           } else {
-            auto best = std::get<1>(incumbent);
-            if (!cmp(bnd,best)) {
-              if constexpr(pruneLevel) {
-                  break;
-                } else {
-                continue;
-              }
+            prune = !cmp(bnd, std::get<1>(incumbent));
+          }
+
+          if (prune) {
+            if constexpr(pruneLevel) {
+              stack.pop_back();
+              --depth;
             }
-        }
+            continue;
+          }
       }
 
       if constexpr(isBnB) {
@@ -117,13 +140,18 @@ struct Seq {
         }
       }
 
-      auto found = expand(space, c, params, incumbent, childDepth + 1, acc);
-      if constexpr(isDecision) {
-        // Propagate early exit
-        if (found) {
-          return true;
+      if constexpr(isEnumeration) {
+        acc.accumulate(c);
+      }
+
+      if constexpr(isDepthBounded) {
+        if (depth + 1 == params.maxDepth) {
+          continue;
         }
       }
+
+      stack.emplace_back(space, c);
+      ++depth;
     }
     return false;
   }
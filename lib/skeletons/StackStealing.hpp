@@ -1,7 +1,12 @@
 #ifndef SKELETONS_STACKSTEAL_HPP
 #define SKELETONS_STACKSTEAL_HPP
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <deque>
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <cstdint>
 
@@ -17,14 +22,13 @@
 #include "util/Incumbent.hpp"
 #include "util/func.hpp"
 #include "util/util.hpp"
+#include "util/Termination.hpp"
 
 #include "Common.hpp"
 
 #include "workstealing/Scheduler.hpp"
 #include "workstealing/policies/SearchManager.hpp"
 
-#include "skeletons/Seq.hpp"
-
 namespace YewPar { namespace Skeletons {
 
 template <typename Generator, typename ...Args>
@@ -66,16 +70,25 @@ struct StackStealing {
     hpx::cout << std::flush;
   }
 
-  static void subTreeTask(const Node initNode,
+  // The id is unused: tasks are tracked by YewPar::Termination counting
+  static void subTreeTask(const Context::Id ctx,
+                          const Node initNode,
                           const unsigned depth,
-                          const hpx::id_type donePromise) {
-    auto reg = Registry<Space, Node, Bound, Enum>::gReg;
+                          const hpx::id_type) {
+    Context::Scope scope(ctx);
+    auto reg = Registry<Space, Node, Bound, Enum>::get();
     Enum acc;
 
-    // Setup the stack with root node
-    StackElem<Generator> rootElem(reg->space, initNode);
+    if (reg->params.passiveSteals) {
+      if constexpr(isEnumeration) {
+        acc.accumulate(initNode);
+      }
+      runPassiveTask(depth, reg->space, initNode, acc);
+      return;
+    }
 
-    GeneratorStack<Generator> generatorStack(maxStackDepth, rootElem);
+    // Setup the stack with root node
+    auto generatorStack = GeneratorStack<Generator>::acquire(reg->space, initNode);
 
     if constexpr(isEnumeration) {
         acc.accumulate(initNode);
@@ -84,9 +97,9 @@ struct StackStealing {
     // Register with the Policy to allow stealing from this stack
     std::shared_ptr<SharedState> stealReq;
     unsigned threadId;
-    std::tie(stealReq, threadId) = std::static_pointer_cast<Policy>(Workstealing::Scheduler::local_policy)->registerThread();
+    std::tie(stealReq, threadId) = std::static_pointer_cast<Policy>(Workstealing::Scheduler::getPolicy())->registerThread();
 
-    runTaskFromStack(depth, reg->space, generatorStack, stealReq, acc, donePromise, threadId);
+    runTaskFromStack(depth, reg->space, *generatorStack, stealReq, acc, threadId);
   }
 
   using SubTreeTask = func<
@@ -97,29 +110,227 @@ struct StackStealing {
   using Response    = typename Policy::Response_t;
   using SharedState = typename Policy::SharedState_t;
 
-  // Find the (approx) required depth<Generator> to create "totalThreads" tasks
-  static unsigned getRequiredSpawnDepth(const Space & space,
-                                        const Node & root,
-                                        const YewPar::Skeletons::API::Params<Bound> params,
-                                        const unsigned totalThreads) {
-
-    auto depthRequired = 1;
-    while (depthRequired <= params.maxDepth) {
-      auto localParams = params;
-      localParams.maxDepth = depthRequired;
-      std::uint64_t numNodes = YewPar::Skeletons::Seq<Generator,
-                                             YewPar::Skeletons::API::Enumeration,
-                                             YewPar::Skeletons::API::Enumerator<CountNodesEnumerator<Node>>,
-                                             YewPar::Skeletons::API::BoundFunction<boundFn>,
-                                             YewPar::Skeletons::API::ObjectiveComparison<Objcmp>,
-                                             YewPar::Skeletons::API::DepthLimited>
-                      ::search(space, root, localParams);
-      if (numNodes >= totalThreads) {
-        break;
+  // A search stack thieves take work from without the owner's help. Each open
+  // level publishes its parent node and a claim word (generation << 32 | next
+  // child index). The owner and thieves both claim the next child index
+  // atomically: the owner then steps its generator past any children taken by
+  // thieves, while a thief regenerates its child from the published parent.
+  // This needs generators to produce the same children in the same order
+  // every time, which they do as functions of (space, node).
+  //
+  // Closing a level (or reopening it for another node) moves the claim word
+  // on so in flight thieves can't claim from the old node.
+  class PassiveStack : public Workstealing::Policies::StealableStack<Node> {
+   public:
+    struct Published {
+      Node parent;
+      unsigned numChildren;
+      std::uint32_t generation;
+      int childDepth;
+    };
+
+   private:
+    struct Level {
+      std::atomic<std::uint64_t> claim {0};
+      std::shared_ptr<const Published> pub;
+      std::uint32_t generation = 0;
+    };
+
+    static constexpr unsigned chunkSize = 128;
+    static constexpr unsigned maxChunks = 1024;
+    static constexpr std::uint64_t closedIdx = 0xFFFFFFFF;
+
+    const Space & space;
+
+    // Levels are allocated in chunks on first use and never move
+    std::array<std::atomic<Level *>, maxChunks> chunks;
+    std::atomic<unsigned> numLevels {0};
+
+    Level * level(unsigned i) const {
+      auto c = chunks[i / chunkSize].load(std::memory_order_acquire);
+      return c ? &c[i % chunkSize] : nullptr;
+    }
+
+   public:
+    PassiveStack(const Space & space) : space(space) {
+      for (auto & c : chunks) {
+        c.store(nullptr, std::memory_order_relaxed);
+      }
+    }
+
+    ~PassiveStack() {
+      for (auto & c : chunks) {
+        delete[] c.load();
+      }
+    }
+
+    // Owner only: publish pub as level i
+    void open(unsigned i, std::shared_ptr<Published> pub) {
+      auto & c = chunks[i / chunkSize];
+      if (!c.load(std::memory_order_relaxed)) {
+        c.store(new Level[chunkSize], std::memory_order_release);
       }
-      ++depthRequired;
+      auto l = level(i);
+
+      pub->generation = ++l->generation;
+      std::atomic_store(&l->pub, std::shared_ptr<const Published>(std::move(pub)));
+      l->claim.store(static_cast<std::uint64_t>(l->generation) << 32);
+
+      numLevels.store(i + 1);
+    }
+
+    // Owner only: index of the next child at level i not taken by a thief,
+    // or -1 once there are none left
+    std::int64_t claimNext(unsigned i, unsigned numChildren) {
+      auto idx = level(i)->claim.fetch_add(1) & closedIdx;
+      return idx < numChildren ? static_cast<std::int64_t>(idx) : -1;
+    }
+
+    // Owner only: stop thieves claiming from level i
+    void close(unsigned i) {
+      auto l = level(i);
+      l->claim.store((static_cast<std::uint64_t>(l->generation) << 32) | closedIdx);
+      numLevels.store(i);
+    }
+
+    bool trySteal(Node & n, int & depth) override {
+      const auto top = numLevels.load();
+
+      // Shallowest first: those subtrees are likely the largest
+      for (unsigned i = 0; i < top; ++i) {
+        auto l = level(i);
+        if (!l) {
+          return false;
+        }
+        auto pub = std::atomic_load(&l->pub);
+        if (!pub) {
+          continue;
+        }
+
+        auto c = l->claim.load();
+        while ((c >> 32) == pub->generation && (c & closedIdx) < pub->numChildren) {
+          // Count the task first: once the claim succeeds the owner may finish
+          Termination::taskCreated();
+          if (l->claim.compare_exchange_weak(c, c + 1)) {
+            Generator gen(space, pub->parent);
+            for (std::uint64_t skip = 0; skip < (c & closedIdx); ++skip) {
+              gen.next();
+            }
+            n = gen.next();
+            depth = pub->childDepth;
+            return true;
+          }
+          Termination::taskCompleted();
+        }
+      }
+      return false;
+    }
+  };
+
+  // As runWithStack, but thieves take work directly from stack
+  static void runWithPassiveStack(const int startingDepth,
+                                  const Space & space,
+                                  const Node & root,
+                                  PassiveStack & stack,
+                                  Enum & acc) {
+    auto reg = Registry<Space, Node, Bound, Enum>::get();
+
+    struct Frame {
+      std::shared_ptr<typename PassiveStack::Published> pub;
+      Generator gen;
+      unsigned pos;
+
+      Frame(const Space & space, std::shared_ptr<typename PassiveStack::Published> p)
+          : pub(std::move(p)), gen(space, pub->parent), pos(0) {}
+    };
+
+    // Frames never move, generators reference their published parent
+    std::deque<Frame> frames;
+
+    auto push = [&](Node n) {
+      const unsigned i = frames.size();
+      auto pub = std::make_shared<typename PassiveStack::Published>();
+      pub->parent = std::move(n);
+      frames.emplace_back(space, pub);
+      pub->numChildren = frames.back().gen.numChildren;
+      pub->childDepth = startingDepth + i + 1;
+      stack.open(i, std::move(pub));
+    };
+
+    auto pop = [&]() {
+      stack.close(frames.size() - 1);
+      frames.pop_back();
+    };
+
+    push(root);
+
+    while (!frames.empty()) {
+      if constexpr(isDecision) {
+        if (reg->stopSearch) {
+          break;
+        }
+      }
+
+      const unsigned stackDepth = frames.size() - 1;
+      auto & top = frames.back();
+
+      auto idx = stack.claimNext(stackDepth, top.pub->numChildren);
+      if (idx < 0) {
+        pop();
+        continue;
+      }
+
+      // Step over the children thieves took
+      while (top.pos < idx) {
+        top.gen.next();
+        ++top.pos;
+      }
+      auto child = top.gen.next();
+      ++top.pos;
+
+      auto pn = ProcessNode<Space, Node, Args...>::processNode(reg->params, space, child, acc);
+      if (pn == ProcessNodeRet::Exit) { break; }
+      else if (pn == ProcessNodeRet::Prune) { continue; }
+      else if (pn == ProcessNodeRet::Break) {
+        pop();
+        continue;
+      }
+
+      if constexpr(isDepthBounded) {
+        if (startingDepth + stackDepth + 1 == reg->params.maxDepth) {
+          continue;
+        }
+      }
+
+      push(std::move(child));
+    }
+
+    while (!frames.empty()) {
+      pop();
     }
-    return depthRequired;
+  }
+
+  // Run a task on a passive stack (params.passiveSteals)
+  static void runPassiveTask(const unsigned startingDepth,
+                             const Space & space,
+                             const Node & root,
+                             Enum & acc) {
+    auto reg = Registry<Space, Node, Bound, Enum>::get();
+    auto policy = std::static_pointer_cast<Policy>(Workstealing::Scheduler::getPolicy());
+
+    auto stack = std::make_shared<PassiveStack>(space);
+    auto threadId = std::get<1>(policy->registerThread(stack));
+
+    runWithPassiveStack(startingDepth, space, root, *stack, acc);
+
+    if constexpr(isEnumeration) {
+        reg->updateEnumerator(acc);
+    }
+
+    policy->unregisterThread(threadId);
+
+    // Anything stolen from us was counted when it was claimed
+    Termination::taskCompleted();
   }
 
   // TODO: We only need the depth for counting so need to constexpr more
@@ -128,11 +339,9 @@ struct StackStealing {
                            GeneratorStack<Generator> & generatorStack,
                            std::shared_ptr<SharedState> stealRequest,
                            Enum & acc,
-                           std::vector<hpx::future<void> > & futures,
                            int stackDepth = 0,
                            int depth = -1) {
-    auto reg = Registry<Space, Node, Bound, Enum>::gReg;
-    std::vector<hpx::distributed::promise<void> > promises;
+    auto reg = Registry<Space, Node, Bound, Enum>::get();
 
     // We do this because arguments can't default initialise to themselves
     if (depth == -1) {
@@ -159,13 +368,11 @@ struct StackStealing {
               while (generatorStack[i].seen < generatorStack[i].gen.numChildren) {
                 generatorStack[i].seen++;
 
-                promises.emplace_back();
-                auto & prom = promises.back();
-
-                futures.push_back(prom.get_future());
+                // Counted before this task can complete
+                Termination::taskCreated();
 
                 const auto stolenSol = generatorStack[i].gen.next();
-                res.emplace_back(hpx::make_tuple(stolenSol, startingDepth + i + 1, prom.get_id()));
+                res.emplace_back(hpx::make_tuple(stolenSol, startingDepth + i + 1, hpx::invalid_id));
               }
 
               std::get<1>(*stealRequest).set(res);
@@ -175,13 +382,10 @@ struct StackStealing {
             } else {
               generatorStack[i].seen++;
 
-              promises.emplace_back();
-              auto & prom = promises.back();
-
-              futures.push_back(prom.get_future());
+              Termination::taskCreated();
 
               const auto stolenSol = generatorStack[i].gen.next();
-              Response res {hpx::make_tuple(stolenSol, startingDepth + i + 1, prom.get_id())};
+              Response res {hpx::make_tuple(stolenSol, startingDepth + i + 1, hpx::invalid_id)};
               std::get<1>(*stealRequest).set(res);
 
               responded = true;
@@ -200,8 +404,7 @@ struct StackStealing {
       if (generatorStack[stackDepth].seen < generatorStack[stackDepth].gen.numChildren) {
 
         // Get the next child at this stackDepth
-        generatorStack[stackDepth + 1].node = generatorStack[stackDepth].gen.next();
-        auto & child = generatorStack[stackDepth + 1].node;
+        auto child = generatorStack[stackDepth].gen.next();
 
         generatorStack[stackDepth].seen++;
 
@@ -214,24 +417,16 @@ struct StackStealing {
           continue;
         }
 
-        // Get the child's generator
-        const auto childGen = Generator(space, child);
-
-        // Going down
-        stackDepth++;
-        depth++;
-
         if constexpr(isDepthBounded) {
-            // This doesn't look quite right to me, we want the next element at this level not the previous?
-            if (depth == reg->params.maxDepth) {
-              stackDepth--;
-              depth--;
-              continue;
+          if (depth + 1 == reg->params.maxDepth) {
+            continue;
           }
         }
 
-        generatorStack[stackDepth].seen = 0;
-        generatorStack[stackDepth].gen = childGen;
+        // Going down, building the child's generator in place
+        stackDepth++;
+        depth++;
+        generatorStack.place(stackDepth, space, std::move(child));
       } else {
         stackDepth--;
         depth--;
@@ -245,108 +440,137 @@ struct StackStealing {
                                 GeneratorStack<Generator> & generatorStack,
                                 const std::shared_ptr<SharedState> stealRequest,
                                 Enum & acc,
-                                const hpx::id_type donePromise,
                                 const unsigned searchManagerId,
                                 const int stackDepth = 0,
                                 const int depth = -1) {
-    auto reg = Registry<Space, Node, Bound, Enum>::gReg;
-    std::vector<hpx::future<void> > futures;
+    auto reg = Registry<Space, Node, Bound, Enum>::get();
 
-    runWithStack(startingDepth, space, generatorStack, stealRequest, acc, futures, stackDepth, depth);
+    runWithStack(startingDepth, space, generatorStack, stealRequest, acc, stackDepth, depth);
 
-    // Atomically updates the (process) local counter
+    // Adds to this worker thread's (process local) counter
     if constexpr(isEnumeration) {
         reg->updateEnumerator(acc);
     }
 
-    std::static_pointer_cast<Policy>(Workstealing::Scheduler::local_policy)->unregisterThread(searchManagerId);
+    std::static_pointer_cast<Policy>(Workstealing::Scheduler::getPolicy())->unregisterThread(searchManagerId);
 
-    termination_wait_act act;
-    hpx::post(act, hpx::find_here(), std::move(futures), donePromise);
+    // Anything stolen from us was counted when it was handed out
+    Termination::taskCompleted();
   }
 
 
-  // Action to push a new scheduler running this skeleton to a distributed node
-  // (for setting initial work distribution)
-  static void addWork (const Node initNode,
-                       const unsigned depth,
-                       const hpx::id_type donePromise) {
-    hpx::execution::parallel_executor exe(hpx::threads::thread_priority::critical,
-                                          hpx::threads::thread_stacksize::huge);
-    hpx::function<void(),false> fn = hpx::bind(SubTreeTask::fn_ptr(), initNode, depth, donePromise);
-    auto f = hpx::bind(&Workstealing::Scheduler::scheduler, fn);
-    hpx::async(exe, f);
+  // Run a batch of initial tasks one after the other. Other threads can
+  // steal from whichever task is currently running. The tasks are counted as
+  // created by the master before the batch is sent.
+  static void runInitialTasks(const std::vector<Node> taskRoots,
+                              const unsigned depth) {
+    for (const auto & n : taskRoots) {
+      subTreeTask(Context::current(), n, depth, hpx::invalid_id);
+    }
+  }
+
+  // Action to hand a batch of initial tasks to a scheduler on a distributed
+  // node (for setting initial work distribution)
+  static void addWork (const Context::Id ctx,
+                       const std::vector<Node> taskRoots,
+                       const unsigned depth) {
+    Context::Scope scope(ctx);
+    hpx::function<void(),false> fn = hpx::bind(&runInitialTasks, taskRoots, depth);
+    Workstealing::Scheduler::addTask(std::move(fn));
   }
   struct addWorkAct : hpx::actions::make_action<
     decltype(&StackStealing<Generator, Args...>::addWork),
     &StackStealing<Generator, Args...>::addWork,
     addWorkAct>::type {};
 
-  static void spawnInitialWork(const unsigned depthRequired,
-                               const unsigned tasksRequired,
-                               int & stackDepth,
-                               int & depth,
-                               const Space & space,
-                               GeneratorStack<Generator> & generatorStack,
-                               Enum & acc,
-                               std::vector<hpx::future<void> > & futures){
+  // Expand the tree breadth first, a level at a time, until there are at least
+  // totalThreads nodes at the frontier (or the tree/depth limit runs out).
+  // Expanded nodes are accumulated here; frontier nodes are accumulated by the
+  // task that searches them. Returns the depth of the frontier nodes, or 0 if
+  // the search finished early (decision problems).
+  static unsigned findInitialWork(const Space & space,
+                                  const Node & root,
+                                  const API::Params<Bound> & params,
+                                  const unsigned totalThreads,
+                                  Enum & acc,
+                                  std::vector<Node> & frontier) {
+    frontier.clear();
+    frontier.push_back(root);
 
-    auto reg = Registry<Space, Node, Bound, Enum>::gReg;
-    auto localities = util::findOtherLocalities();
-    localities.push_back(hpx::find_here());
+    auto depth = 1;
+    while (frontier.size() < totalThreads) {
+      // runWithStack never expands nodes at maxDepth so neither can a task root
+      if constexpr(isDepthBounded) {
+        if (depth + 1 >= params.maxDepth) {
+          break;
+        }
+      }
 
-    auto tasksSpawned = 0;
-    while (stackDepth >= 0) {
-      // If there's still children at this stackDepth we move into them
-      if (generatorStack[stackDepth].seen < generatorStack[stackDepth].gen.numChildren) {
+      std::vector<Node> nextLevel;
+      for (const auto & n : frontier) {
+        if constexpr(isEnumeration) {
+          acc.accumulate(n);
+        }
 
-        // Get the next child at this stackDepth
-        generatorStack[stackDepth + 1].node = generatorStack[stackDepth].gen.next();
-        auto & child = generatorStack[stackDepth + 1].node;
+        auto newCands = Generator(space, n);
+        for (auto i = 0; i < newCands.numChildren; ++i) {
+          auto c = newCands.next();
 
-        generatorStack[stackDepth].seen++;
+          // Enumeration nodes are only counted once expanded (or by their task)
+          if constexpr(!isEnumeration) {
+            auto pn = ProcessNode<Space, Node, Args...>::processNode(params, space, c, acc);
+            if (pn == ProcessNodeRet::Exit) { return 0; }
+            else if (pn == ProcessNodeRet::Prune) { continue; }
+            else if (pn == ProcessNodeRet::Break) { break; }
+          }
 
-        // Going down
-        stackDepth++;
-        depth++;
+          nextLevel.push_back(std::move(c));
+        }
+      }
+
+      frontier = std::move(nextLevel);
+      ++depth;
+
+      if (frontier.empty()) {
+        break;
+      }
+    }
 
-        // Push anything at this depth as a task
-        if (stackDepth == depthRequired) {
-          hpx::distributed::promise<void> prom;
-          auto f = prom.get_future();
-          auto pid = prom.get_id();
-          futures.push_back(std::move(f));
+    return depth;
+  }
 
-          // This needs to go to localities no managers now
-          auto mgr = tasksSpawned % localities.size();
-          hpx::async<addWorkAct>(localities[mgr], child, depth, pid);
+  // Split the frontier into one batch per worker thread (slot), each batch
+  // run by a scheduler on the slot's locality. Nodes are handed out largest
+  // estimated subtree first to the least loaded batch.
+  static void spawnInitialWork(const std::vector<Node> & frontier,
+                               const unsigned depth,
+                               const API::Params<Bound> & params,
+                               const std::vector<hpx::id_type> & slots) {
+    const auto & space = Registry<Space, Node, Bound, Enum>::get()->space;
+    const unsigned probeDepth = isDepthBounded ? params.maxDepth - depth : params.maxDepth;
+
+    std::vector<std::pair<double, unsigned> > sizes;
+    for (auto i = 0; i < frontier.size(); ++i) {
+      sizes.emplace_back(estimateSubtreeSize<Generator>(space, frontier[i], probeDepth), i);
+    }
+    std::sort(sizes.begin(), sizes.end(), std::greater<std::pair<double, unsigned> >());
+
+    std::vector<std::vector<Node> > batches(std::min(slots.size(), frontier.size()));
+    std::vector<double> loads(batches.size(), 0);
+    for (const auto & s : sizes) {
+      auto b = std::distance(loads.begin(), std::min_element(loads.begin(), loads.end()));
+      batches[b].push_back(frontier[s.second]);
+      loads[b] += s.first;
+    }
 
-          stackDepth--;
-          depth--;
-          tasksSpawned++;
+    Termination::taskCreated(frontier.size());
 
-          // We keep a spare thread for ourselves to execute as
-          if (tasksSpawned == tasksRequired) {
-            break;
-          }
-        } else {
-          // Need to process nodes we don't spawn to ensure correct enumeration etc
-          auto pn = ProcessNode<Space, Node, Args...>::processNode(reg->params, space, child, acc);
-          if (pn == ProcessNodeRet::Exit) { return; }
-          else if (pn == ProcessNodeRet::Prune) { continue; }
-          else if (pn == ProcessNodeRet::Break) {
-            stackDepth--;
-            depth--;
-            continue;
-          }
-          // Get the child's generator
-          const auto childGen = Generator(space, child);
-          generatorStack[stackDepth].seen = 0;
-          generatorStack[stackDepth].gen = childGen;
-        }
+    for (auto i = 0; i < batches.size(); ++i) {
+      auto loc = slots[i];
+      if (loc == hpx::find_here()) {
+        addWork(Context::current(), std::move(batches[i]), depth);
       } else {
-        stackDepth--;
-        depth--;
+        hpx::post<addWorkAct>(loc, Context::current(), std::move(batches[i]), depth);
       }
     }
   }
@@ -355,54 +579,42 @@ struct StackStealing {
                        const Node & root,
                        const API::Params<Bound> & params) {
 
-    // FIXME: Assumes homogeneous machines
-    unsigned totalThreads = 0;
-    if (hpx::get_os_thread_count() == 1) {
-      totalThreads = hpx::find_all_localities().size();
-    } else {
-      totalThreads = hpx::find_all_localities().size() * (hpx::get_os_thread_count() - 1);
-    }
+    // Localities may have different numbers of workers
+    auto slots = util::findWorkerSlots();
+    unsigned totalThreads = slots.size();
 
-    // Master stack
-    StackElem<Generator> rootElem(space, root);
+    if (totalThreads == 1 && params.passiveSteals) {
+      Enum acc;
+      acc.accumulate(root);
 
-    GeneratorStack<Generator> genStack(maxStackDepth, rootElem);
+      Termination::taskCreated();
+      runPassiveTask(1, space, root, acc);
+    } else if (totalThreads == 1) {
+      // Master stack
+      auto genStack = GeneratorStack<Generator>::acquire(space, root);
 
-    Enum acc;
-    acc.accumulate(root);
+      Enum acc;
+      acc.accumulate(root);
 
-    auto stackDepth = 0;
-    auto depth = 1;
+      auto searchMgrInfo = std::static_pointer_cast<Policy>(Workstealing::Scheduler::getPolicy())->registerThread();
 
-    std::vector<hpx::future<void> > futures;
-    if (totalThreads > 1) {
-      auto depthRequired = getRequiredSpawnDepth(space, root, params, totalThreads);
-      spawnInitialWork(depthRequired, totalThreads - 1, stackDepth, depth, space, genStack, acc, futures);
-    }
-
-    // Register the rest of the work from the main thread with the search manager
-    auto searchMgrInfo = std::static_pointer_cast<Policy>(Workstealing::Scheduler::local_policy)->registerThread();
-    auto stealRequest  = std::get<0>(searchMgrInfo);
+      Termination::taskCreated();
+      runTaskFromStack(1, space, *genStack, std::get<0>(searchMgrInfo), acc, std::get<1>(searchMgrInfo));
+    } else {
+      Enum acc;
+      std::vector<Node> frontier;
+      auto depth = findInitialWork(space, root, params, totalThreads, acc, frontier);
 
-    // Continue the actual work
-    hpx::distributed::promise<void> prom;
-    auto f = prom.get_future();
-    auto pid = prom.get_id();
+      if constexpr(isEnumeration) {
+        Registry<Space, Node, Bound, Enum>::get()->updateEnumerator(acc);
+      }
 
-    // Launch initialising thread as a new Scheduler
-    if (totalThreads == 1) {
-      runTaskFromStack(1, space, genStack, stealRequest, acc, pid, std::get<1>(searchMgrInfo), stackDepth, depth);
-    } else {
-      // Not clear this is executing?
-      hpx::execution::parallel_executor exe(hpx::threads::thread_priority::critical,
-                                            hpx::threads::thread_stacksize::huge);
-      hpx::function<void(), false> fn = hpx::bind(&runTaskFromStack, 1, space, genStack, stealRequest, acc, pid, std::get<1>(searchMgrInfo), stackDepth, depth);
-      auto f = hpx::bind(&Workstealing::Scheduler::scheduler, fn);
-      hpx::async(exe, f);
+      if (depth > 0) {
+        spawnInitialWork(frontier, depth, params, slots);
+      }
     }
 
-    futures.push_back(std::move(f));
-    hpx::wait_all(futures);
+    Termination::waitForTermination();
   }
 
   static auto search (const Space & space,
@@ -412,22 +624,27 @@ struct StackStealing {
       printSkeletonDetails(params);
     }
 
+    Context::SearchScope ctx;
+
     hpx::wait_all(hpx::lcos::broadcast<InitRegistryAct<Space, Node, Bound, Enum> >(
-        hpx::find_all_localities(), space, root, params));
+        hpx::find_all_localities(), ctx.id(), space, root, params));
 
     Policy::initPolicy();
 
+    hpx::wait_all(hpx::lcos::broadcast<Workstealing::Scheduler::startLocalSchedulers_act>(
+        hpx::find_all_localities()));
+
     if constexpr(isOptimisation || isDecision) {
       auto inc = hpx::new_<Incumbent>(hpx::find_here()).get();
       hpx::wait_all(hpx::lcos::broadcast<UpdateGlobalIncumbentAct<Space, Node, Bound, Enum> >(
-          hpx::find_all_localities(), inc));
+          hpx::find_all_localities(), ctx.id(), inc));
       initIncumbent<Space, Node, Bound, Enum, Objcmp, Verbose>(root, params.initialBound);
     }
 
     doSearch(space, root, params);
 
     hpx::wait_all(hpx::lcos::broadcast<Workstealing::Scheduler::stopSchedulers_act>(
-        hpx::find_all_localities()));
+        hpx::find_all_localities(), ctx.id()));
 
     hpx::cout << std::flush;
 
@@ -442,10 +659,7 @@ struct StackStealing {
     if constexpr(isEnumeration) {
       return combineEnumerators<Space, Node, Bound, Enum>();
     } else if constexpr(isOptimisation || isDecision) {
-      auto reg = Registry<Space, Node, Bound, Enum>::gReg;
-
-      typedef typename Incumbent::GetIncumbentAct<Node, Bound, Objcmp, Verbose> getInc;
-      return hpx::async<getInc>(reg->globalIncumbent).get();
+      return getIncumbent<Space, Node, Bound, Enum, Objcmp, Verbose>();
     } else {
       static_assert(isEnumeration || isOptimisation || isDecision, "Please provide a supported search type: Enumeration, Optimisation, Decision");
     }
@@ -0,0 +1,124 @@
+#ifndef YEWPAR_BATCH_HPP
+#define YEWPAR_BATCH_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <hpx/collectives/broadcast.hpp>
+#include <hpx/iostream.hpp>
+#include <hpx/runtime_distributed/find_all_localities.hpp>
+
+#include "workstealing/Scheduler.hpp"
+
+namespace YewPar { namespace Batch {
+
+// Solve many instances in one process so the HPX runtime, component types and
+// schedulers are only started once. Each instance is solved with a fresh
+// search (and search context), so instances don't share any search state.
+
+// The input files of one instance, e.g. a single graph or a pattern and
+// target pair
+using Instance = std::vector<std::string>;
+
+// Instances named by path. A directory gives one single file instance per
+// regular file in it, in name order. Any other file is a list with one
+// instance per line: whitespace separated file names, relative to the list's
+// directory unless absolute. Blank lines and lines starting with '#' are
+// skipped. Throws std::runtime_error if the path can't be read.
+inline std::vector<Instance> findInstances(const std::string & path) {
+  namespace fs = std::filesystem;
+  std::vector<Instance> instances;
+
+  if (fs::is_directory(path)) {
+    for (const auto & e : fs::directory_iterator(path)) {
+      if (e.is_regular_file()) {
+        instances.push_back({e.path().string()});
+      }
+    }
+    std::sort(instances.begin(), instances.end());
+    return instances;
+  }
+
+  std::ifstream list(path);
+  if (!list) {
+    throw std::runtime_error("Unable to read instance list " + path);
+  }
+
+  const auto dir = fs::path(path).parent_path();
+  std::string line;
+  while (std::getline(list, line)) {
+    std::istringstream fields(line);
+    Instance inst;
+    std::string f;
+    while (fields >> f) {
+      if (inst.empty() && f[0] == '#') {
+        break;
+      }
+      auto p = fs::path(f);
+      inst.push_back(p.is_absolute() ? f : (dir / p).string());
+    }
+    if (!inst.empty()) {
+      instances.push_back(std::move(inst));
+    }
+  }
+  return instances;
+}
+
+// Solve every instance in turn with solve, which returns EXIT_SUCCESS or
+// EXIT_FAILURE and prints its own results. Each instance's output is preceded
+// by "instance = <files>" and followed by its wall time (including parsing) as
+// "instance time = <ms>". An instance that fails or throws doesn't stop the
+// batch. Schedulers are kept running on every locality for the whole batch.
+//
+// Returns EXIT_FAILURE if any instance failed.
+inline int run(const std::vector<Instance> & instances,
+               std::function<int(const Instance &)> solve) {
+  hpx::wait_all(hpx::lcos::broadcast<Workstealing::Scheduler::startLocalSchedulers_act>(
+      hpx::find_all_localities()));
+
+  auto failures = 0;
+  for (const auto & inst : instances) {
+    hpx::cout << "instance =";
+    for (const auto & f : inst) {
+      hpx::cout << " " << f;
+    }
+    hpx::cout << std::endl;
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    auto res = EXIT_FAILURE;
+    try {
+      res = solve(inst);
+    } catch (const std::exception & e) {
+      hpx::cout << "error = " << e.what() << std::endl;
+    }
+
+    auto time = std::chrono::duration_cast<std::chrono::milliseconds>
+        (std::chrono::steady_clock::now() - start_time);
+    hpx::cout << "instance time = " << time.count() << std::endl;
+
+    if (res != EXIT_SUCCESS) {
+      ++failures;
+    }
+  }
+
+  hpx::wait_all(hpx::lcos::broadcast<Workstealing::Scheduler::releaseSchedulers_act>(
+      hpx::find_all_localities()));
+
+  hpx::cout << "instances = " << instances.size() << ", failed = " << failures << std::endl;
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+}}
+
+#endif
@@ -0,0 +1,269 @@
+#ifndef YEWPAR_CONTEXT_HPP
+#define YEWPAR_CONTEXT_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <hpx/modules/threading_base.hpp>
+#include <hpx/synchronization/spinlock.hpp>
+#include <hpx/thread.hpp>
+
+namespace YewPar { namespace Context {
+
+// A search context owns everything one search keeps on a locality: its
+// registry, scheduling policy and termination counts. Several searches, even
+// of the same types, can then share the process and its worker threads.
+//
+// Every HPX thread works for at most one context, recorded in the thread's
+// data word. Search code finds its state through current(). Actions that
+// cross localities carry the context explicitly and open a Scope for it.
+//
+// An Id is a slot (reused by later contexts) tagged with a generation, so
+// late messages for a finished search can be told apart from messages for
+// the next search in the same slot.
+using Id = std::uint32_t;
+
+// Slot 0 is never handed out: it is the context of code outside any search
+constexpr unsigned maxContexts = 4096;
+
+inline unsigned slot(Id ctx) {
+  return ctx & 0xFFFF;
+}
+
+inline Id current() {
+  auto self = hpx::threads::get_self_id();
+  if (self == hpx::threads::invalid_thread_id) {
+    return 0;
+  }
+  return static_cast<Id>(hpx::threads::get_thread_data(self));
+}
+
+// Run the calling HPX thread on behalf of ctx until the scope ends
+class Scope {
+ private:
+  Id prev;
+
+  static void set(Id ctx) {
+    auto self = hpx::threads::get_self_id();
+    if (self != hpx::threads::invalid_thread_id) {
+      hpx::threads::set_thread_data(self, ctx);
+    }
+  }
+
+ public:
+  explicit Scope(Id ctx) : prev(current()) {
+    set(ctx);
+  }
+
+  ~Scope() {
+    set(prev);
+  }
+
+  Scope(const Scope &) = delete;
+  Scope & operator=(const Scope &) = delete;
+};
+
+namespace detail {
+
+struct Allocator {
+  hpx::spinlock mtx;
+  std::vector<unsigned> freeSlots;
+  unsigned nextSlot = 1;
+  std::array<std::uint16_t, maxContexts> generation {};
+};
+
+inline Allocator & allocator() {
+  static Allocator a;
+  return a;
+}
+
+}
+
+// Receives progress events of a search, e.g. "incumbent 42" for each
+// improved bound. Called from search threads, so it must not block for long.
+using Reporter = std::function<void(const std::string &)>;
+
+namespace detail {
+
+struct Reporters {
+  hpx::spinlock mtx;
+  // Waiting for the next search started by the HPX thread
+  std::vector<std::pair<hpx::threads::thread_id_type, Reporter> > pending;
+  // Searches with a reporter, only on the locality that started them
+  std::vector<std::pair<Id, Reporter> > active;
+  std::atomic<unsigned> numActive {0};
+};
+
+inline Reporters & reporters() {
+  static Reporters r;
+  return r;
+}
+
+// Hand a reporter waiting on the calling thread over to its new search
+inline void adoptReporter(Id ctx) {
+  auto & r = reporters();
+  auto self = hpx::threads::get_self_id();
+  std::lock_guard<hpx::spinlock> l(r.mtx);
+  auto it = std::find_if(r.pending.begin(), r.pending.end(),
+                         [&](const auto & p) { return p.first == self; });
+  if (it != r.pending.end()) {
+    r.active.emplace_back(ctx, it->second);
+    r.numActive++;
+  }
+}
+
+inline void dropReporter(Id ctx) {
+  auto & r = reporters();
+  if (r.numActive.load() == 0) {
+    return;
+  }
+  std::lock_guard<hpx::spinlock> l(r.mtx);
+  auto it = std::find_if(r.active.begin(), r.active.end(),
+                         [&](const auto & p) { return p.first == ctx; });
+  if (it != r.active.end()) {
+    r.active.erase(it);
+    r.numActive--;
+  }
+}
+
+}
+
+// Report the progress of searches the calling HPX thread starts (one at a
+// time) until the scope ends
+class ReportScope {
+ private:
+  hpx::threads::thread_id_type self;
+
+ public:
+  explicit ReportScope(Reporter reporter) : self(hpx::threads::get_self_id()) {
+    auto & r = detail::reporters();
+    std::lock_guard<hpx::spinlock> l(r.mtx);
+    r.pending.emplace_back(self, std::move(reporter));
+  }
+
+  ~ReportScope() {
+    auto & r = detail::reporters();
+    std::lock_guard<hpx::spinlock> l(r.mtx);
+    r.pending.erase(std::remove_if(r.pending.begin(), r.pending.end(),
+                                   [&](const auto & p) { return p.first == self; }),
+                    r.pending.end());
+  }
+
+  ReportScope(const ReportScope &) = delete;
+  ReportScope & operator=(const ReportScope &) = delete;
+};
+
+// Cheap check, so callers only build events someone will receive
+inline bool reporting() {
+  return detail::reporters().numActive.load() > 0;
+}
+
+inline void report(Id ctx, const std::string & event) {
+  Reporter fn;
+  {
+    auto & r = detail::reporters();
+    std::lock_guard<hpx::spinlock> l(r.mtx);
+    auto it = std::find_if(r.active.begin(), r.active.end(),
+                           [&](const auto & p) { return p.first == ctx; });
+    if (it == r.active.end()) {
+      return;
+    }
+    fn = it->second;
+  }
+  fn(event);
+}
+
+// Allocate a context for a new search. Only the locality starting the search
+// allocates, every other locality just uses the Id it is sent. Waits if every
+// slot is in use.
+inline Id acquire() {
+  auto & a = detail::allocator();
+  for (;;) {
+    {
+      std::lock_guard<hpx::spinlock> l(a.mtx);
+      unsigned s = 0;
+      if (!a.freeSlots.empty()) {
+        s = a.freeSlots.back();
+        a.freeSlots.pop_back();
+      } else if (a.nextSlot < maxContexts) {
+        s = a.nextSlot++;
+      }
+
+      if (s != 0) {
+        auto gen = ++a.generation[s];
+        return (static_cast<Id>(gen) << 16) | s;
+      }
+    }
+    hpx::this_thread::yield();
+  }
+}
+
+inline void release(Id ctx) {
+  auto & a = detail::allocator();
+  std::lock_guard<hpx::spinlock> l(a.mtx);
+  a.freeSlots.push_back(slot(ctx));
+}
+
+// A new context for the search the calling thread is about to run. The
+// thread works for it until the scope ends, when the context is freed for
+// later searches.
+class SearchScope {
+ private:
+  Id ctx;
+  Scope scope;
+
+ public:
+  SearchScope() : ctx(acquire()), scope(ctx) {
+    detail::adoptReporter(ctx);
+  }
+
+  ~SearchScope() {
+    detail::dropReporter(ctx);
+    release(ctx);
+  }
+
+  Id id() const {
+    return ctx;
+  }
+};
+
+// One T per context slot on this locality. Each is created the first time its
+// slot is used and then reused by later contexts in that slot, so nothing is
+// allocated per search once the process is warm.
+template <typename T>
+class PerContext {
+ private:
+  std::array<std::atomic<T *>, maxContexts> slots;
+
+ public:
+  PerContext() {
+    for (auto & s : slots) {
+      s.store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  T & get(Id ctx) {
+    auto & s = slots[slot(ctx)];
+    auto p = s.load(std::memory_order_acquire);
+    if (!p) {
+      auto fresh = new T();
+      if (s.compare_exchange_strong(p, fresh)) {
+        p = fresh;
+      } else {
+        delete fresh;
+      }
+    }
+    return *p;
+  }
+};
+
+}}
+
+#endif
@@ -50,14 +50,13 @@ struct Incumbent : public hpx::components::locking_hook<
       bnd = b;
     }
 
+    // Localities send their best node once the search ends (new bounds are
+    // reported as they are found, see Skeletons::updateIncumbent)
     void updateIncumbent(Node incumbent) {
       Cmp cmp;
       if (cmp(incumbent.getObj(), incumbentNode.getObj())) {
         incumbentNode = incumbent;
         bnd = incumbent.getObj();
-        if constexpr(verbose >= 1) {
-          hpx::cout << (boost::format("New Incumbent Bound: %1%\n") % incumbentNode.getObj()) << std::flush;
-        }
       }
     }
 
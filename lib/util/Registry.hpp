@@ -6,19 +6,34 @@
 #include <cstdint>
 #include <iterator>
 #include <memory>
+#include <sstream>
 #include <vector>
 
 #include <hpx/modules/actions_base.hpp>
+#include <hpx/modules/runtime_distributed.hpp>
+#include <hpx/runtime_distributed/find_all_localities.hpp>
 #include <hpx/synchronization/mutex.hpp>
 
 #include "skeletons/API.hpp"
+#include "Context.hpp"
 #include "Enumerator.hpp"
+#include "TaskFlags.hpp"
 
 namespace YewPar {
 
 template <typename Space, typename Node, typename Bound, typename Enumerator>
 struct Registry {
-  static Registry<Space, Node, Bound, Enumerator>* gReg;
+  // The registry of search context ctx on this locality, by default the
+  // context the calling thread is working for
+  static Registry<Space, Node, Bound, Enumerator>* get(Context::Id ctx = Context::current()) {
+    static Context::PerContext<Registry<Space, Node, Bound, Enumerator> > registries;
+    return &registries.get(ctx);
+  }
+
+  using MutexT = hpx::mutex;
+
+  // The search currently using this registry
+  Context::Id ctx = 0;
 
   // General parameters
   Space space;
@@ -30,37 +45,110 @@ struct Registry {
   std::atomic<Bound> localBound;
   hpx::id_type globalIncumbent;
 
+  // Best node found on this locality. It is only sent to globalIncumbent once
+  // the search ends, in the meantime only its bound is propagated.
+  Node bestNode;
+  Bound bestBound;
+  bool haveBestNode = false;
+  MutexT bestMtx;
+
+  // Set while a (coalesced) bound propagation is scheduled or in flight
+  std::atomic<bool> flushPending {false};
+  Bound lastSentBound;
+
+  // Localities in broadcast tree order and our position in it
+  std::vector<hpx::id_type> localities;
+  std::size_t localityRank = 0;
+
   // Decision problems
   std::atomic<bool> stopSearch {false};
   hpx::id_type foundPromiseId;
 
-  // Counting Nodes
-  Enumerator acc;
-  using MutexT = hpx::mutex;
+  // Counting Nodes. One accumulator per worker thread, so finishing a task
+  // never contends, plus a shared one (under mtx) for non-worker threads. HPX
+  // threads can't be suspended inside updateEnumerator, so each worker's slot
+  // has a single writer at a time. Slots are only combined once the search
+  // has terminated.
+  struct alignas(64) EnumSlot {
+    Enumerator acc;
+  };
+  std::unique_ptr<EnumSlot[]> accs;
+  std::size_t numAccs;
   MutexT mtx;
+
+  using ResT = typename Enumerator::ResT;
+
+  // Ordered - per task started flags and results. Results and the real flags
+  // are on the locality that spawned the tasks, other localities keep the
+  // flags they have learnt are set.
+  util::TaskFlags startedFlags;
+  std::vector<ResT> taskResults;
   // using countMapT = std::vector<std::atomic<std::uint64_t> >;
   // std::unique_ptr<std::vector<std::atomic<std::uint64_t> > > counts;
 
-  // We construct this object globally at compile time (see below) so this can't
-  // happen in the constructor and should instead be called as an action on each
-  // locality.
-  void initialise(Space space, Node root, Skeletons::API::Params<Bound> params) {
+  Registry() : numAccs(hpx::get_os_thread_count() + 1) {
+    accs.reset(new EnumSlot[numAccs]);
+  }
+
+  // Registries are reused by later searches in the same context slot, so this
+  // can't happen in the constructor and should instead be called as an action
+  // on each locality.
+  void initialise(Context::Id ctx, Space space, Node root, Skeletons::API::Params<Bound> params) {
+    this->ctx = ctx;
     this->space = space;
     this->root = root;
     this->params = params;
     this->localBound = params.initialBound;
-    this->acc = Enumerator();
+    for (auto i = 0; i < numAccs; ++i) {
+      accs[i].acc = Enumerator();
+    }
+    this->stopSearch = false;
+
+    this->haveBestNode = false;
+    this->lastSentBound = params.initialBound;
+    this->localities = hpx::find_all_localities();
+    this->localityRank = std::distance(localities.begin(),
+                                       std::find(localities.begin(), localities.end(), hpx::find_here()));
   }
 
   // Counting
   void updateEnumerator(Enumerator & e) {
-    std::lock_guard<MutexT> l(mtx);
-    acc.combine(e.get());
+    const auto w = hpx::get_worker_thread_num();
+    if (w < numAccs - 1) {
+      accs[w].acc.combine(e.get());
+    } else {
+      std::lock_guard<MutexT> l(mtx);
+      accs[numAccs - 1].acc.combine(e.get());
+    }
   }
 
-  using ResT = typename Enumerator::ResT;
+  // Only valid once the search has terminated
   ResT getEnumeratorVal() {
-    return acc.get();
+    Enumerator res;
+    for (auto i = 0; i < numAccs; ++i) {
+      res.combine(accs[i].acc.get());
+    }
+    return res.get();
+  }
+
+  // Ordered
+  void initTasks(std::size_t numTasks) {
+    startedFlags.reset(numTasks);
+    taskResults.clear();
+    taskResults.resize(numTasks);
+  }
+
+  void initTaskFlags(std::size_t numTasks) {
+    startedFlags.reset(numTasks);
+  }
+
+  bool claimTask(unsigned idx) {
+    return startedFlags.claim(idx);
+  }
+
+  // Each task only runs once so there is no need to lock here
+  void setTaskResult(unsigned idx, ResT res) {
+    taskResults[idx] = std::move(res);
   }
 
   // BNB
@@ -74,70 +162,171 @@ struct Registry {
       }
 
       if (localBound.compare_exchange_weak(curBound, bnd)) {
+        if (Context::reporting()) {
+          std::ostringstream event;
+          event << "incumbent " << bnd;
+          Context::report(ctx, event.str());
+        }
         break;
       }
     }
   }
 
+  // Record a node found on this locality, returns true if it is the best so far
+  template <typename Cmp>
+  bool updateBestNode(const Node & n, Bound bnd) {
+    std::lock_guard<MutexT> l(bestMtx);
+    Cmp cmp;
+    if (haveBestNode && !cmp(bnd, bestBound)) {
+      return false;
+    }
+    bestNode = n;
+    bestBound = bnd;
+    haveBestNode = true;
+    return true;
+  }
+
   void setStopSearchFlag() {
     stopSearch.store(true);
   }
 
 };
 
-template<typename Space, typename Node, typename Bound, typename Enumerator>
-Registry<Space, Node, Bound, Enumerator>* Registry<Space, Node, Bound, Enumerator>::gReg = new Registry<Space, Node, Bound, Enumerator>;
-
-// Easy calling
+// Easy calling. Actions name their search context explicitly since they don't
+// run on a thread working for it.
 template <typename Space, typename Node, typename Bound, typename Enumerator>
-void initialiseRegistry(Space space, Node root, YewPar::Skeletons::API::Params<Bound> params) {
-  Registry<Space, Node, Bound, Enumerator>::gReg->initialise(space, root, params);
+void initialiseRegistry(Context::Id ctx, Space space, Node root, YewPar::Skeletons::API::Params<Bound> params) {
+  Registry<Space, Node, Bound, Enumerator>::get(ctx)->initialise(ctx, space, root, params);
 }
 template <typename Space, typename Node, typename Bound, typename Enumerator>
 struct InitRegistryAct : hpx::actions::make_direct_action<
   decltype(&initialiseRegistry<Space, Node, Bound, Enumerator>), &initialiseRegistry<Space, Node, Bound, Enumerator>, InitRegistryAct<Space, Node, Bound, Enumerator> >::type {};
 
 template <typename Space, typename Node, typename Bound, typename Enumerator>
-typename Enumerator::ResT getEnumeratorVal() {
-  return Registry<Space, Node, Bound, Enumerator>::gReg->getEnumeratorVal();
-}
-template <typename Space, typename Node, typename Bound, typename Enumerator>
-struct GetEnumeratorValAct : hpx::actions::make_direct_action<
-  decltype(&getEnumeratorVal<Space, Node, Bound, Enumerator>), &getEnumeratorVal<Space, Node, Bound, Enumerator>, GetEnumeratorValAct<Space, Node, Bound, Enumerator> >::type {};
-
-template <typename Space, typename Node, typename Bound, typename Enumerator>
-void setStopSearchFlag() {
-  Registry<Space, Node, Bound, Enumerator>::gReg->setStopSearchFlag();
+void setStopSearchFlag(Context::Id ctx) {
+  auto reg = Registry<Space, Node, Bound, Enumerator>::get(ctx);
+  // Late for a search that has already finished
+  if (reg->ctx != ctx) {
+    return;
+  }
+  reg->setStopSearchFlag();
 }
 template <typename Space, typename Node, typename Bound, typename Enumerator>
 struct SetStopFlagAct : hpx::actions::make_direct_action<
   decltype(&setStopSearchFlag<Space, Node, Bound, Enumerator>), &setStopSearchFlag<Space, Node, Bound, Enumerator>, SetStopFlagAct<Space, Node, Bound, Enumerator> >::type {};
 
 template <typename Space, typename Node, typename Bound, typename Enumerator, typename Cmp>
-void updateRegistryBound(Bound bnd) {
-  auto reg = Registry<Space, Node, Bound, Enumerator>::gReg;
+void updateRegistryBound(Context::Id ctx, Bound bnd) {
+  auto reg = Registry<Space, Node, Bound, Enumerator>::get(ctx);
+  if (reg->ctx != ctx) {
+    return;
+  }
   (*reg).template updateRegistryBound<Cmp>(bnd);
 }
 template <typename Space, typename Node, typename Bound, typename Enumerator, typename Cmp>
 struct UpdateRegistryBoundAct : hpx::actions::make_direct_action<
   decltype(&updateRegistryBound<Space, Node, Bound, Enumerator, Cmp>), &updateRegistryBound<Space, Node, Bound, Enumerator, Cmp>, UpdateRegistryBoundAct<Space, Node, Bound, Enumerator, Cmp> >::type {};
 
+// Update the bound on every locality along a binary tree rooted at the sender
+// (rank root), so no locality sends more than two messages. Returns once the
+// whole subtree below this locality has the bound.
+template <typename Space, typename Node, typename Bound, typename Enumerator, typename Cmp>
+struct PropagateBoundAct;
+
+template <typename Space, typename Node, typename Bound, typename Enumerator, typename Cmp>
+void propagateBound(Context::Id ctx, Bound bnd, std::size_t root) {
+  auto reg = Registry<Space, Node, Bound, Enumerator>::get(ctx);
+  if (reg->ctx != ctx) {
+    return;
+  }
+  (*reg).template updateRegistryBound<Cmp>(bnd);
+
+  const auto n   = reg->localities.size();
+  const auto rel = (reg->localityRank + n - root) % n;
+
+  std::vector<hpx::future<void> > children;
+  for (auto c = 2 * rel + 1; c <= 2 * rel + 2 && c < n; ++c) {
+    children.push_back(hpx::async<PropagateBoundAct<Space, Node, Bound, Enumerator, Cmp> >(
+        reg->localities[(c + root) % n], ctx, bnd, root));
+  }
+  hpx::wait_all(children);
+}
+template <typename Space, typename Node, typename Bound, typename Enumerator, typename Cmp>
+struct PropagateBoundAct : hpx::actions::make_action<
+  decltype(&propagateBound<Space, Node, Bound, Enumerator, Cmp>), &propagateBound<Space, Node, Bound, Enumerator, Cmp>, PropagateBoundAct<Space, Node, Bound, Enumerator, Cmp> >::type {};
+
+// Combine the enumerators of every locality along a binary tree rooted at
+// rank root, so no locality receives more than two partial results. Returns
+// the combined value of the subtree below this locality.
+template <typename Space, typename Node, typename Bound, typename Enumerator>
+struct ReduceEnumeratorsAct;
+
+template <typename Space, typename Node, typename Bound, typename Enumerator>
+typename Enumerator::ResT reduceEnumerators(Context::Id ctx, std::size_t root) {
+  auto reg = Registry<Space, Node, Bound, Enumerator>::get(ctx);
+
+  const auto n   = reg->localities.size();
+  const auto rel = (reg->localityRank + n - root) % n;
+
+  std::vector<hpx::future<typename Enumerator::ResT> > children;
+  for (auto c = 2 * rel + 1; c <= 2 * rel + 2 && c < n; ++c) {
+    children.push_back(hpx::async<ReduceEnumeratorsAct<Space, Node, Bound, Enumerator> >(
+        reg->localities[(c + root) % n], ctx, root));
+  }
+
+  Enumerator res;
+  res.combine(reg->getEnumeratorVal());
+  for (auto & f : children) {
+    res.combine(f.get());
+  }
+  return res.get();
+}
+template <typename Space, typename Node, typename Bound, typename Enumerator>
+struct ReduceEnumeratorsAct : hpx::actions::make_action<
+  decltype(&reduceEnumerators<Space, Node, Bound, Enumerator>), &reduceEnumerators<Space, Node, Bound, Enumerator>, ReduceEnumeratorsAct<Space, Node, Bound, Enumerator> >::type {};
+
 template <typename Space, typename Node, typename Bound, typename Enumerator>
-void updateGlobalIncumbent(hpx::id_type inc) {
-  Registry<Space, Node, Bound, Enumerator>::gReg->globalIncumbent = inc;
+void updateGlobalIncumbent(Context::Id ctx, hpx::id_type inc) {
+  Registry<Space, Node, Bound, Enumerator>::get(ctx)->globalIncumbent = inc;
 }
 template <typename Space, typename Node, typename Bound, typename Enumerator>
 struct UpdateGlobalIncumbentAct : hpx::actions::make_direct_action<
   decltype(&updateGlobalIncumbent<Space, Node, Bound, Enumerator>), &updateGlobalIncumbent<Space, Node, Bound, Enumerator>, UpdateGlobalIncumbentAct<Space, Node, Bound, Enumerator> >::type {};
 
 template <typename Space, typename Node, typename Bound, typename Enumerator>
-void setFoundPromiseId(hpx::id_type id) {
-  Registry<Space, Node, Bound, Enumerator>::gReg->foundPromiseId = id;
+void setFoundPromiseId(Context::Id ctx, hpx::id_type id) {
+  Registry<Space, Node, Bound, Enumerator>::get(ctx)->foundPromiseId = id;
 }
 template <typename Space, typename Node, typename Bound, typename Enumerator>
 struct SetFoundPromiseIdAct : hpx::actions::make_direct_action<
   decltype(&setFoundPromiseId<Space, Node, Bound, Enumerator>), &setFoundPromiseId<Space, Node, Bound, Enumerator>, SetFoundPromiseIdAct<Space, Node, Bound, Enumerator> >::type {};
 
+template <typename Space, typename Node, typename Bound, typename Enumerator>
+void initTaskFlags(Context::Id ctx, std::size_t numTasks) {
+  Registry<Space, Node, Bound, Enumerator>::get(ctx)->initTaskFlags(numTasks);
+}
+template <typename Space, typename Node, typename Bound, typename Enumerator>
+struct InitTaskFlagsAct : hpx::actions::make_direct_action<
+  decltype(&initTaskFlags<Space, Node, Bound, Enumerator>), &initTaskFlags<Space, Node, Bound, Enumerator>, InitTaskFlagsAct<Space, Node, Bound, Enumerator> >::type {};
+
+// Claims flag idx and returns its word from before the claim (see
+// TaskFlags::claimWord)
+template <typename Space, typename Node, typename Bound, typename Enumerator>
+std::uint64_t claimTaskFlag(Context::Id ctx, unsigned idx) {
+  return Registry<Space, Node, Bound, Enumerator>::get(ctx)->startedFlags.claimWord(idx);
+}
+template <typename Space, typename Node, typename Bound, typename Enumerator>
+struct ClaimTaskFlagAct : hpx::actions::make_direct_action<
+  decltype(&claimTaskFlag<Space, Node, Bound, Enumerator>), &claimTaskFlag<Space, Node, Bound, Enumerator>, ClaimTaskFlagAct<Space, Node, Bound, Enumerator> >::type {};
+
+template <typename Space, typename Node, typename Bound, typename Enumerator>
+void setTaskResult(Context::Id ctx, unsigned idx, typename Enumerator::ResT res) {
+  Registry<Space, Node, Bound, Enumerator>::get(ctx)->setTaskResult(idx, std::move(res));
+}
+template <typename Space, typename Node, typename Bound, typename Enumerator>
+struct SetTaskResultAct : hpx::actions::make_direct_action<
+  decltype(&setTaskResult<Space, Node, Bound, Enumerator>), &setTaskResult<Space, Node, Bound, Enumerator>, SetTaskResultAct<Space, Node, Bound, Enumerator> >::type {};
+
 } // YewPar
 
 namespace hpx { namespace traits {
@@ -161,13 +350,33 @@ struct action_stacksize<YewPar::UpdateRegistryBoundAct<Space, Node, Bound, Enume
   static constexpr threads::thread_stacksize value = threads::thread_stacksize::medium;
 };
 
+template <typename Space, typename Node, typename Bound, typename Enumerator, typename Cmp>
+struct action_stacksize<YewPar::PropagateBoundAct<Space, Node, Bound, Enumerator, Cmp> > {
+  static constexpr threads::thread_stacksize value = threads::thread_stacksize::medium;
+};
+
 template <typename Space, typename Node, typename Bound, typename Enumerator>
 struct action_stacksize<YewPar::SetStopFlagAct<Space, Node, Bound, Enumerator> > {
   static constexpr threads::thread_stacksize value = threads::thread_stacksize::medium;
 };
 
 template <typename Space, typename Node, typename Bound, typename Enumerator>
-struct action_stacksize<YewPar::GetEnumeratorValAct<Space, Node, Bound, Enumerator> > {
+struct action_stacksize<YewPar::ReduceEnumeratorsAct<Space, Node, Bound, Enumerator> > {
+  static constexpr threads::thread_stacksize value = threads::thread_stacksize::medium;
+};
+
+template <typename Space, typename Node, typename Bound, typename Enumerator>
+struct action_stacksize<YewPar::InitTaskFlagsAct<Space, Node, Bound, Enumerator> > {
+  static constexpr threads::thread_stacksize value = threads::thread_stacksize::medium;
+};
+
+template <typename Space, typename Node, typename Bound, typename Enumerator>
+struct action_stacksize<YewPar::ClaimTaskFlagAct<Space, Node, Bound, Enumerator> > {
+  static constexpr threads::thread_stacksize value = threads::thread_stacksize::medium;
+};
+
+template <typename Space, typename Node, typename Bound, typename Enumerator>
+struct action_stacksize<YewPar::SetTaskResultAct<Space, Node, Bound, Enumerator> > {
   static constexpr threads::thread_stacksize value = threads::thread_stacksize::medium;
 };
 
@@ -0,0 +1,274 @@
+#ifndef YEWPAR_SERVICE_HPP
+#define YEWPAR_SERVICE_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <hpx/collectives/broadcast.hpp>
+#include <hpx/iostream.hpp>
+#include <hpx/modules/program_options.hpp>
+#include <hpx/runtime_distributed/find_all_localities.hpp>
+#include <hpx/runtime_local/run_as_hpx_thread.hpp>
+#include <hpx/runtime_local/run_as_os_thread.hpp>
+#include <hpx/synchronization/spinlock.hpp>
+
+#include "Context.hpp"
+#include "workstealing/Scheduler.hpp"
+
+namespace YewPar { namespace Service {
+
+// A long running search service. The runtime and schedulers are started once
+// and searches (jobs) are taken from a Unix domain socket, so jobs don't pay
+// the process start up cost and workers stay warm between them.
+//
+// Protocol, one job per connection:
+//  - The client sends one line: the app's command line options for the job,
+//    e.g. "--skeleton depthbounded -d 2 --input-file brock200_1.clq"
+//  - The service replies with lines: "incumbent <bound>" whenever the search
+//    improves its bound, then the app's usual output, then
+//    "done <exit status> <ms>" before closing the connection.
+//  - The line "shutdown" stops the service once running jobs have finished.
+//
+// Jobs run concurrently, each as its own search context.
+
+// Runs the job described by opts, printing its results to out. Returns
+// EXIT_SUCCESS or EXIT_FAILURE.
+using Handler = std::function<int(hpx::program_options::variables_map & opts, std::ostream & out)>;
+
+namespace detail {
+
+// One client. Whole lines are sent under a lock since the job's output and
+// its incumbent reports come from different threads.
+class Connection {
+ private:
+  int fd;
+  hpx::spinlock mtx;
+
+ public:
+  explicit Connection(int fd) : fd(fd) {}
+
+  ~Connection() {
+    ::close(fd);
+  }
+
+  // A client that has gone away is ignored, the job still runs to the end
+  void sendLine(const std::string & line) {
+    std::lock_guard<hpx::spinlock> l(mtx);
+    auto msg = line + "\n";
+    std::size_t sent = 0;
+    while (sent < msg.size()) {
+      auto n = ::send(fd, msg.data() + sent, msg.size() - sent, MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        return;
+      }
+      sent += n;
+    }
+  }
+
+  // Blocking, only called from the connection's own OS thread
+  bool readLine(std::string & line) {
+    line.clear();
+    char c;
+    for (;;) {
+      auto n = ::recv(fd, &c, 1, 0);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        return !line.empty();
+      }
+      if (c == '\n') {
+        return true;
+      }
+      if (c != '\r') {
+        line.push_back(c);
+      }
+    }
+  }
+};
+
+// Forwards everything written to an ostream to a connection, line by line
+class LineBuf : public std::streambuf {
+ private:
+  std::shared_ptr<Connection> conn;
+  std::string line;
+
+ protected:
+  int overflow(int c) override {
+    if (c == traits_type::eof()) {
+      return traits_type::not_eof(c);
+    }
+    if (c == '\n') {
+      conn->sendLine(line);
+      line.clear();
+    } else {
+      line.push_back(static_cast<char>(c));
+    }
+    return c;
+  }
+
+ public:
+  explicit LineBuf(std::shared_ptr<Connection> conn) : conn(std::move(conn)) {}
+
+  ~LineBuf() {
+    if (!line.empty()) {
+      conn->sendLine(line);
+    }
+  }
+};
+
+// Runs on an HPX thread
+inline void runJob(const Handler & handler,
+                   const hpx::program_options::options_description & desc,
+                   const std::vector<std::string> & args,
+                   std::shared_ptr<Connection> conn) {
+  auto start_time = std::chrono::steady_clock::now();
+
+  auto res = EXIT_FAILURE;
+  {
+    LineBuf buf(conn);
+    std::ostream out(&buf);
+
+    Context::ReportScope report([conn](const std::string & event) {
+      conn->sendLine(event);
+    });
+
+    try {
+      hpx::program_options::variables_map opts;
+      hpx::program_options::store(
+          hpx::program_options::command_line_parser(args).options(desc).run(), opts);
+      hpx::program_options::notify(opts);
+      res = handler(opts, out);
+    } catch (const std::exception & e) {
+      out << "error = " << e.what() << std::endl;
+    }
+  }
+
+  auto time = std::chrono::duration_cast<std::chrono::milliseconds>
+      (std::chrono::steady_clock::now() - start_time);
+  conn->sendLine("done " + std::to_string(res) + " " + std::to_string(time.count()));
+}
+
+}
+
+// Serve jobs on socketPath (replacing any stale socket there) until a
+// client asks for shutdown. Jobs are parsed with desc and run by handler.
+inline int serve(const std::string & socketPath,
+                 const hpx::program_options::options_description & desc,
+                 Handler handler) {
+  sockaddr_un addr {};
+  addr.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "Socket path too long: " << socketPath << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::strcpy(addr.sun_path, socketPath.c_str());
+
+  int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+  // Only ever remove a stale socket, never whatever else the path names
+  struct stat st;
+  if (listenFd >= 0 && ::lstat(socketPath.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+    ::unlink(socketPath.c_str());
+  }
+
+  if (listenFd < 0 ||
+      ::bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+      ::listen(listenFd, SOMAXCONN) < 0) {
+    std::cerr << "Unable to listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+    if (listenFd >= 0) {
+      ::close(listenFd);
+    }
+    return EXIT_FAILURE;
+  }
+
+  hpx::wait_all(hpx::lcos::broadcast<Workstealing::Scheduler::startLocalSchedulers_act>(
+      hpx::find_all_localities()));
+
+  hpx::cout << "Serving jobs on " << socketPath << std::endl;
+
+  // Accepting and reading requests block, so they happen on OS threads (one
+  // per connection) and only the jobs themselves run on HPX threads
+  auto acceptLoop = [&]() {
+    std::atomic<bool> stopping {false};
+    std::mutex mtx;
+    std::condition_variable done_cv;
+    unsigned numConnections = 0;
+
+    while (!stopping) {
+      int fd = ::accept(listenFd, nullptr, nullptr);
+      if (fd < 0) {
+        if (errno == EINTR || errno == ECONNABORTED) {
+          continue;
+        }
+        break;
+      }
+
+      {
+        std::lock_guard<std::mutex> l(mtx);
+        ++numConnections;
+      }
+
+      std::thread([&, fd]() {
+        auto conn = std::make_shared<detail::Connection>(fd);
+
+        std::string line;
+        if (conn->readLine(line)) {
+          if (line == "shutdown") {
+            stopping = true;
+            // Wakes the blocked accept
+            ::shutdown(listenFd, SHUT_RDWR);
+            conn->sendLine("done 0 0");
+          } else {
+            auto args = hpx::program_options::split_unix(line);
+            hpx::threads::run_as_hpx_thread(&detail::runJob, std::cref(handler), std::cref(desc), args, conn);
+          }
+        }
+        conn.reset();
+
+        std::lock_guard<std::mutex> l(mtx);
+        --numConnections;
+        done_cv.notify_all();
+      }).detach();
+    }
+
+    std::unique_lock<std::mutex> l(mtx);
+    done_cv.wait(l, [&]() { return numConnections == 0; });
+  };
+
+  hpx::threads::run_as_os_thread(acceptLoop).get();
+
+  ::close(listenFd);
+  ::unlink(socketPath.c_str());
+
+  hpx::wait_all(hpx::lcos::broadcast<Workstealing::Scheduler::releaseSchedulers_act>(
+      hpx::find_all_localities()));
+
+  return EXIT_SUCCESS;
+}
+
+}}
+
+#endif
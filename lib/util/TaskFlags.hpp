@@ -0,0 +1,64 @@
+#ifndef YEWPAR_TASK_FLAGS_HPP
+#define YEWPAR_TASK_FLAGS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace YewPar { namespace util {
+
+// A fixed number of set-once flags, one per task, packed into a bitmap. Setting
+// a flag is a single atomic fetch-or so, unlike DistSetOnceFlag, nothing needs
+// to be allocated in AGAS for each task. Remote users go through an action on
+// the owning locality (see ClaimTaskFlagAct in Registry.hpp), which returns
+// the whole word so they can cache the flags they learn about.
+class TaskFlags {
+ private:
+  static constexpr unsigned bitsPerWord = 64;
+
+  std::unique_ptr<std::atomic<std::uint64_t>[]> words;
+  std::size_t numWords = 0;
+
+ public:
+  // Clear the bitmap and size it for n flags
+  void reset(std::size_t n) {
+    numWords = (n + bitsPerWord - 1) / bitsPerWord;
+    words.reset(new std::atomic<std::uint64_t>[numWords]);
+    for (auto i = 0; i < numWords; ++i) {
+      words[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  // Set flag idx. Returns true if we were the first to set it.
+  bool claim(std::size_t idx) {
+    const std::uint64_t bit = std::uint64_t(1) << (idx % bitsPerWord);
+    return !(words[idx / bitsPerWord].fetch_or(bit, std::memory_order_acq_rel) & bit);
+  }
+
+  // Set flag idx. Returns the flag's word as it was before: the other flags in
+  // it were set at the time, the caller was first if idx's bit is clear.
+  std::uint64_t claimWord(std::size_t idx) {
+    const std::uint64_t bit = std::uint64_t(1) << (idx % bitsPerWord);
+    return words[idx / bitsPerWord].fetch_or(bit, std::memory_order_acq_rel);
+  }
+
+  // Record that the flags in word (of the word holding idx) are set elsewhere.
+  // Flags are never cleared so stale information is still correct.
+  void merge(std::size_t idx, std::uint64_t word) {
+    words[idx / bitsPerWord].fetch_or(word, std::memory_order_relaxed);
+  }
+
+  static std::uint64_t bit(std::size_t idx) {
+    return std::uint64_t(1) << (idx % bitsPerWord);
+  }
+
+  // Cheap check that avoids the read-modify-write if the flag is already set
+  bool isSet(std::size_t idx) const {
+    const std::uint64_t bit = std::uint64_t(1) << (idx % bitsPerWord);
+    return words[idx / bitsPerWord].load(std::memory_order_acquire) & bit;
+  }
+};
+
+}}
+
+#endif
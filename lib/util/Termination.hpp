@@ -0,0 +1,130 @@
+#ifndef YEWPAR_TERMINATION_HPP
+#define YEWPAR_TERMINATION_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <hpx/modules/actions_base.hpp>
+#include <hpx/modules/runtime_distributed.hpp>
+#include <hpx/runtime_distributed/find_all_localities.hpp>
+#include <hpx/datastructures/tuple.hpp>
+#include <hpx/thread.hpp>
+
+#include "Context.hpp"
+
+namespace YewPar { namespace Termination {
+
+// Distributed termination detection by counting tasks, replacing a promise
+// (and global id) per task.
+//
+// A task must be counted as created before anyone can run it and as completed
+// only after it has created all of its children, so while any task is live the
+// global created count is strictly greater than the completed count. Counts
+// are kept per worker thread so counting never contends.
+//
+// The search master polls every locality in waves. Counts only ever increase,
+// so two consecutive waves reading the same totals means nothing happened
+// anywhere between them: the second wave is then a consistent snapshot, and
+// equal created/completed counts mean all tasks have finished.
+//
+// Counts are kept per search context. They are never reset: a context slot
+// reused by a later search starts from balanced counts, which is all the
+// waves need.
+struct alignas(64) WorkerCounts {
+  std::atomic<std::uint64_t> created {0};
+  std::atomic<std::uint64_t> completed {0};
+};
+
+// One slot per worker thread plus a shared slot for non-worker threads
+struct ContextCounts {
+  std::unique_ptr<WorkerCounts[]> cs;
+
+  ContextCounts() : cs(new WorkerCounts[hpx::get_os_thread_count() + 1]) {}
+};
+
+inline WorkerCounts * counts(Context::Id ctx = Context::current()) {
+  static Context::PerContext<ContextCounts> perContext;
+  return perContext.get(ctx).cs.get();
+}
+
+inline WorkerCounts & myCounts() {
+  auto slot = std::min<std::size_t>(hpx::get_worker_thread_num(), hpx::get_os_thread_count());
+  return counts()[slot];
+}
+
+inline void taskCreated(std::uint64_t n = 1) {
+  myCounts().created += n;
+}
+
+inline void taskCompleted() {
+  myCounts().completed++;
+}
+
+// (created, completed) for ctx on this locality
+inline hpx::tuple<std::uint64_t, std::uint64_t> getCounts(Context::Id ctx) {
+  std::uint64_t created = 0, completed = 0;
+  auto cs = counts(ctx);
+  for (auto i = 0; i <= hpx::get_os_thread_count(); ++i) {
+    // Read completed first so a task finishing mid read can't look balanced
+    completed += cs[i].completed.load();
+    created   += cs[i].created.load();
+  }
+  return hpx::make_tuple(created, completed);
+}
+
+}}
+
+HPX_PLAIN_ACTION(YewPar::Termination::getCounts, termination_getCounts_act);
+
+namespace YewPar { namespace Termination {
+
+// Block until every task of the calling thread's search created so far, on
+// any locality, has completed
+inline void waitForTermination() {
+  const auto ctx = Context::current();
+
+  constexpr std::chrono::microseconds minDelay {50};
+  constexpr std::chrono::microseconds maxDelay {5000};
+
+  auto delay = minDelay;
+  std::uint64_t lastCreated = 0, lastCompleted = 0;
+  bool haveLast = false;
+
+  for (;;) {
+    std::vector<hpx::future<hpx::tuple<std::uint64_t, std::uint64_t> > > futs;
+    for (const auto & l : hpx::find_all_localities()) {
+      futs.push_back(hpx::async<termination_getCounts_act>(l, ctx));
+    }
+
+    std::uint64_t created = 0, completed = 0;
+    for (auto & f : futs) {
+      auto c = f.get();
+      created   += hpx::get<0>(c);
+      completed += hpx::get<1>(c);
+    }
+
+    if (created == completed) {
+      if (haveLast && created == lastCreated && completed == lastCompleted) {
+        return;
+      }
+      // Confirm straight away
+      delay = minDelay;
+    } else {
+      delay = std::min(maxDelay, delay * 2);
+    }
+
+    haveLast = true;
+    lastCreated = created;
+    lastCompleted = completed;
+
+    hpx::this_thread::sleep_for(delay);
+  }
+}
+
+}}
+
+#endif
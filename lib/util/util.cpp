@@ -17,4 +17,35 @@ std::vector<hpx::id_type> findOtherLocalities () {
   return locs;
 }
 
+unsigned getNumWorkers() {
+  return hpx::get_os_thread_count() == 1 ? 1 : hpx::get_os_thread_count() - 1;
+}
+
+std::vector<hpx::id_type> findWorkerSlots() {
+  auto locs = findOtherLocalities();
+  locs.push_back(hpx::find_here());
+
+  std::vector<hpx::future<unsigned> > futs;
+  for (const auto & l : locs) {
+    futs.push_back(hpx::async<getNumWorkers_act>(l));
+  }
+
+  std::vector<unsigned> workers;
+  unsigned maxWorkers = 0;
+  for (auto & f : futs) {
+    workers.push_back(f.get());
+    maxWorkers = std::max(maxWorkers, workers.back());
+  }
+
+  std::vector<hpx::id_type> slots;
+  for (auto round = 0; round < maxWorkers; ++round) {
+    for (auto i = 0; i < locs.size(); ++i) {
+      if (round < workers[i]) {
+        slots.push_back(locs[i]);
+      }
+    }
+  }
+  return slots;
+}
+
 }}
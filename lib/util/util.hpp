@@ -2,6 +2,7 @@
 #define YEWPAR_UTIL_HPP
 
 #include <vector>
+#include <hpx/modules/actions_base.hpp>
 #include <hpx/modules/runtime_distributed.hpp>
 
 namespace YewPar { namespace util {
@@ -11,6 +12,16 @@ bool isColocated(hpx::id_type & id);
 // Find all localities except the one the function is called on
 std::vector<hpx::id_type> findOtherLocalities ();
 
+// Number of worker (scheduler) threads skeletons run on this locality. One
+// core is left for HPX unless there is only one.
+unsigned getNumWorkers();
+HPX_DEFINE_PLAIN_ACTION(getNumWorkers, getNumWorkers_act);
+
+// One entry per worker thread over all localities, interleaved so that handing
+// out tasks in order spreads them over localities in proportion to their
+// worker count. The calling locality comes last in each round.
+std::vector<hpx::id_type> findWorkerSlots();
+
 }}
 
 #endif
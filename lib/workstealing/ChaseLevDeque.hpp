@@ -0,0 +1,134 @@
+#ifndef YEWPAR_CHASELEVDEQUE_HPP
+#define YEWPAR_CHASELEVDEQUE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace workstealing {
+
+// Work stealing deque of Chase and Lev ("Dynamic Circular Work-Stealing
+// Deque", SPAA '05) using the C11 memory orderings of Le et al. (PPoPP '13).
+//
+// Exactly one owner may push and pop (LIFO) at the bottom while any number of
+// thieves steal (FIFO) from the top. Elements are owned pointers; whoever
+// removes an element takes ownership of it.
+template <typename T>
+class ChaseLevDeque {
+ private:
+  struct Buffer {
+    std::int64_t capacity;
+    std::unique_ptr<std::atomic<T *>[]> slots;
+
+    explicit Buffer(std::int64_t capacity)
+        : capacity(capacity), slots(new std::atomic<T *>[capacity]) {}
+
+    T * get(std::int64_t i) const {
+      return slots[i & (capacity - 1)].load(std::memory_order_relaxed);
+    }
+
+    void put(std::int64_t i, T * x) {
+      slots[i & (capacity - 1)].store(x, std::memory_order_relaxed);
+    }
+  };
+
+  // Top and bottom are on separate cache lines since thieves and the owner
+  // write them independently
+  alignas(64) std::atomic<std::int64_t> top;
+  alignas(64) std::atomic<std::int64_t> bottom;
+  alignas(64) std::atomic<Buffer *> buffer;
+
+  // Thieves may still be reading a buffer after the owner grows the deque so
+  // old buffers are only freed with the deque. Only the owner touches this.
+  std::vector<std::unique_ptr<Buffer> > buffers;
+
+  Buffer * grow(Buffer * old, std::int64_t b, std::int64_t t) {
+    buffers.push_back(std::make_unique<Buffer>(old->capacity * 2));
+    auto nb = buffers.back().get();
+    for (auto i = t; i < b; ++i) {
+      nb->put(i, old->get(i));
+    }
+    buffer.store(nb, std::memory_order_release);
+    return nb;
+  }
+
+ public:
+  explicit ChaseLevDeque(std::int64_t initialCapacity = 1024) : top(0), bottom(0) {
+    buffers.push_back(std::make_unique<Buffer>(initialCapacity));
+    buffer.store(buffers.back().get(), std::memory_order_relaxed);
+  }
+
+  ChaseLevDeque(const ChaseLevDeque &) = delete;
+  ChaseLevDeque & operator=(const ChaseLevDeque &) = delete;
+
+  ~ChaseLevDeque() {
+    while (auto x = pop()) {
+      delete x;
+    }
+  }
+
+  // Owner only
+  void push(T * x) {
+    auto b = bottom.load(std::memory_order_relaxed);
+    auto t = top.load(std::memory_order_acquire);
+    auto a = buffer.load(std::memory_order_relaxed);
+    if (b - t > a->capacity - 1) {
+      a = grow(a, b, t);
+    }
+    a->put(b, x);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+  }
+
+  // Owner only. Returns nullptr if empty.
+  T * pop() {
+    auto b = bottom.load(std::memory_order_relaxed) - 1;
+    auto a = buffer.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    auto x = a->get(b);
+    if (t == b) {
+      // Last element, race any thieves for it
+      if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        x = nullptr;
+      }
+      bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return x;
+  }
+
+  // Any thread. Returns nullptr if empty or if another thread won the race.
+  T * steal() {
+    auto t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto b = bottom.load(std::memory_order_acquire);
+
+    if (t >= b) {
+      return nullptr;
+    }
+
+    auto a = buffer.load(std::memory_order_acquire);
+    auto x = a->get(t);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return x;
+  }
+
+  // Approximate, for heuristics only
+  bool empty() const {
+    return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+  }
+};
+
+}
+
+#endif
@@ -1,53 +1,151 @@
 #include "DepthPool.hpp"
 
+#include <algorithm>
+
 namespace workstealing {
 
-DepthPool::fnType DepthPool::steal() {
-  DepthPool::fnType task;
+DepthPool::DepthPool() : summary(0) {
+  for (auto & l : levels) {
+    l.store(nullptr, std::memory_order_relaxed);
+  }
+  for (auto & w : occupied) {
+    w.store(0, std::memory_order_relaxed);
+  }
+}
 
-  for (auto i = 0; i <= lowest; ++i) {
-    if (!pools[i].empty()) {
-      auto task = pools[i].front();
-      pools[i].pop();
-      return task;
+DepthPool::~DepthPool() {
+  for (auto & l : levels) {
+    delete l.load();
+  }
+}
+
+DepthPool::Level * DepthPool::getLevel(unsigned depth) {
+  auto l = levels[depth].load(std::memory_order_acquire);
+  if (l) {
+    return l;
+  }
+
+  // Lazily create the level, another thread may beat us to it
+  auto fresh = new Level();
+  if (levels[depth].compare_exchange_strong(l, fresh)) {
+    return fresh;
+  }
+  delete fresh;
+  return l;
+}
+
+void DepthPool::markOccupied(unsigned depth) {
+  auto w = depth / wordBits;
+  occupied[w].fetch_or(std::uint64_t(1) << (depth % wordBits));
+  summary.fetch_or(std::uint64_t(1) << w);
+}
+
+void DepthPool::markEmpty(unsigned depth) {
+  auto w = depth / wordBits;
+  auto bit = std::uint64_t(1) << (depth % wordBits);
+
+  auto remaining = occupied[w].fetch_and(~bit) & ~bit;
+
+  // A push may have landed between our failed pop and clearing the bit
+  if (!levels[depth].load()->tasks.empty()) {
+    markOccupied(depth);
+    return;
+  }
+
+  if (remaining == 0) {
+    summary.fetch_and(~(std::uint64_t(1) << w));
+    if (occupied[w].load() != 0) {
+      summary.fetch_or(std::uint64_t(1) << w);
     }
   }
-  return nullptr;
 }
 
-DepthPool::fnType DepthPool::getLocal() {
-  DepthPool::fnType task;
-  if (pools[lowest].empty()) {
-    return nullptr;
-  } else {
-    task = pools[lowest].front();
-    pools[lowest].pop();
+int DepthPool::deepest() const {
+  auto s = summary.load();
+  while (s) {
+    auto w = wordBits - 1 - __builtin_clzll(s);
+    auto o = occupied[w].load();
+    if (o) {
+      return w * wordBits + (wordBits - 1 - __builtin_clzll(o));
+    }
+    s &= ~(std::uint64_t(1) << w);
   }
+  return -1;
+}
 
-  // Update lowest pointer if required
-  while (lowest > 0) {
-    if (pools[lowest].empty()) {
-        --lowest;
-    } else {
-      break;
+int DepthPool::shallowest() const {
+  auto s = summary.load();
+  while (s) {
+    auto w = __builtin_ctzll(s);
+    auto o = occupied[w].load();
+    if (o) {
+      return w * wordBits + __builtin_ctzll(o);
     }
+    s &= s - 1;
   }
+  return -1;
+}
+
+DepthPool::fnType DepthPool::popFrom(bool deepestFirst) {
+  for (;;) {
+    auto depth = deepestFirst ? deepest() : shallowest();
+    if (depth < 0) {
+      return nullptr;
+    }
 
-  return task;
+    auto l = levels[depth].load();
+    fnType task;
+    if (l->tasks.pop_right(task)) {
+      l->count--;
+      count--;
+      return task;
+    }
+    markEmpty(depth);
+  }
 }
 
-void DepthPool::addWork(DepthPool::fnType task, unsigned depth) {
-  // Resize if we need to. We don't want this to happen too often, so we double it if we need to.
-  if (depth >= max_depth) {
-    max_depth = max_depth * 2;
-    pools.resize(max_depth);
+DepthPool::fnType DepthPool::steal() {
+  return popFrom(false);
+}
+
+std::vector<DepthPool::fnType> DepthPool::stealBatch() {
+  std::vector<fnType> res;
+  for (;;) {
+    auto depth = shallowest();
+    if (depth < 0) {
+      return res;
+    }
+
+    auto l = levels[depth].load();
+    const std::size_t n = std::min(maxStealBatch, std::max<std::int64_t>(1, l->count.load() / 2));
+
+    fnType task;
+    while (res.size() < n && l->tasks.pop_right(task)) {
+      l->count--;
+      count--;
+      res.push_back(std::move(task));
+    }
+    if (!res.empty()) {
+      return res;
+    }
+    markEmpty(depth);
   }
+}
 
-  pools[depth].push(task);
+DepthPool::fnType DepthPool::getLocal() {
+  return popFrom(true);
+}
 
-  if (depth > lowest) {
-    lowest = depth;
+void DepthPool::addWork(DepthPool::fnType task, unsigned depth) {
+  if (depth >= maxDepth) {
+    depth = maxDepth - 1;
   }
+
+  auto l = getLevel(depth);
+  l->count++;
+  count++;
+  l->tasks.push_left(std::move(task));
+  markOccupied(depth);
 }
 
 }
@@ -60,4 +158,5 @@ HPX_REGISTER_COMPONENT(DepthPool_type, DepthPool);
 
 HPX_REGISTER_ACTION(workstealing::DepthPool::getLocal_action, DepthPool_getLocal_action);
 HPX_REGISTER_ACTION(workstealing::DepthPool::steal_action, DepthPool_steal_action);
+HPX_REGISTER_ACTION(workstealing::DepthPool::stealBatch_action, DepthPool_stealBatch_action);
 HPX_REGISTER_ACTION(workstealing::DepthPool::addWork_action, DepthPool_addWork_action);
@@ -1,9 +1,13 @@
 #ifndef DEPTHPOOL_COMPONENT_HPP
 #define DEPTHPOOL_COMPONENT_HPP
 
-#include <queue>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
 
 #include <hpx/include/components.hpp>
+#include <hpx/concurrency/deque.hpp>
 #include <hpx/functional/function.hpp>
 
 namespace workstealing {
@@ -11,36 +15,75 @@ namespace workstealing {
 // A workqueue that tracks tasks based on the depth in the tree they were created at.
 // This allows high vs low tasks to be distinguished while maintaining heuristics as much as possible.
 // In particular a sequential user should see tasks in the same order as a sequential thread
-// Currently only supports access by a single thread at a time as it's very non trivial to implement lock-free.
-class DepthPool : public hpx::components::locking_hook<
-  hpx::components::component_base<DepthPool>> {
+//
+// Safe for concurrent use by any number of local workers and remote thieves.
+// Each depth has its own lock-free FIFO, allocated the first time a task is
+// added at that depth, and a two level occupancy bitmap finds the deepest
+// (getLocal) or shallowest (steal) non-empty depth with a couple of bit scans.
+// Bits may be set for depths that have since emptied, but are never clear
+// while a depth holds tasks.
+class DepthPool : public hpx::components::component_base<DepthPool> {
  private:
   using fnType = hpx::distributed::function<void(hpx::id_type)>;
 
-  std::vector< std::queue<fnType> > pools;
+  struct Level {
+    hpx::lockfree::deque<fnType> tasks;
+    // Approximate, for sizing batched steals
+    std::atomic<std::int64_t> count {0};
+  };
 
-  // For quicker access
-  unsigned lowest = 0;
-  unsigned max_depth;
+  static constexpr unsigned wordBits = 64;
+
+  // Tasks created deeper than this share the deepest level
+  static constexpr unsigned maxDepth = wordBits * wordBits;
+
+  std::array<std::atomic<Level *>, maxDepth> levels;
+
+  // Bit d % 64 of occupied[d / 64] is set if depth d may have tasks, and bit
+  // w of summary is set if occupied[w] may be non zero
+  std::array<std::atomic<std::uint64_t>, wordBits> occupied;
+  std::atomic<std::uint64_t> summary;
+
+  std::atomic<std::int64_t> count {0};
+
+  Level * getLevel(unsigned depth);
+
+  void markOccupied(unsigned depth);
+
+  // Clear depth's bit after a failed pop, unless work arrived concurrently
+  void markEmpty(unsigned depth);
+
+  // Deepest/shallowest depth that may have tasks or -1 if there are none
+  int deepest() const;
+  int shallowest() const;
+
+  fnType popFrom(bool deepestFirst);
 
  public:
-  DepthPool() {
-    // TODO: Size should be settable/dynamic. Currently the same as the default max_depth
-    max_depth = 5000;
-    pools.resize(max_depth);
-  }
+  DepthPool();
+  ~DepthPool();
 
   fnType getLocal();
   HPX_DEFINE_COMPONENT_ACTION(DepthPool, getLocal);
   fnType steal();
   HPX_DEFINE_COMPONENT_ACTION(DepthPool, steal);
+  // Steal half the tasks (at least one, at most maxStealBatch) at the
+  // shallowest non-empty depth
+  std::vector<fnType> stealBatch();
+  HPX_DEFINE_COMPONENT_ACTION(DepthPool, stealBatch);
   void addWork(fnType task, unsigned depth);
   HPX_DEFINE_COMPONENT_ACTION(DepthPool, addWork);
+
+  static constexpr std::int64_t maxStealBatch = 32;
+
+  // Approximate number of queued tasks (local use only)
+  std::int64_t size() const { return count.load(std::memory_order_relaxed); }
 };
 }
 
 HPX_REGISTER_ACTION_DECLARATION(workstealing::DepthPool::getLocal_action, DepthPool_getLocal_action);
 HPX_REGISTER_ACTION_DECLARATION(workstealing::DepthPool::steal_action, DepthPool_steal_action);
+HPX_REGISTER_ACTION_DECLARATION(workstealing::DepthPool::stealBatch_action, DepthPool_stealBatch_action);
 HPX_REGISTER_ACTION_DECLARATION(workstealing::DepthPool::addWork_action, DepthPool_addWork_action);
 
 #endif
@@ -4,6 +4,7 @@ namespace workstealing {
 
 
 PriorityWorkqueue::funcType PriorityWorkqueue::steal() {
+  std::lock_guard<hpx::spinlock> l(mtx);
   if (!tasks.empty()) {
     auto task = tasks.top();
     tasks.pop();
@@ -13,10 +14,12 @@ PriorityWorkqueue::funcType PriorityWorkqueue::steal() {
 }
 
 void PriorityWorkqueue::addWork(int priority, PriorityWorkqueue::funcType task) {
+  std::lock_guard<hpx::spinlock> l(mtx);
   tasks.push(hpx::make_tuple(priority, std::move(task)));
 }
 
 bool PriorityWorkqueue::workRemaining() {
+  std::lock_guard<hpx::spinlock> l(mtx);
   return tasks.empty();
 }
 }
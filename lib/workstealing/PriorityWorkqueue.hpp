@@ -1,19 +1,23 @@
 #ifndef PRIORITY_WORKQUEUE_COMPONENT_HPP
 #define PRIORITY_WORKQUEUE_COMPONENT_HPP
 
+#include <mutex>
 #include <queue>
 #include <vector>
 
 #include <hpx/include/components.hpp>
 #include <hpx/functional/function.hpp>
+#include <hpx/synchronization/spinlock.hpp>
 
 namespace workstealing
 {
-  class PriorityWorkqueue : public hpx::components::locking_hook<
-    hpx::components::component_base<PriorityWorkqueue>
-    >
+  // Locks internally, rather than with a locking_hook, so a colocated policy
+  // can call it directly
+  class PriorityWorkqueue : public hpx::components::component_base<PriorityWorkqueue>
     {
     private:
+        hpx::spinlock mtx;
+
         using funcType  = hpx::distributed::function<void(hpx::id_type)>;
         using queueType = hpx::tuple<int, funcType>;
 
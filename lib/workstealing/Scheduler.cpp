@@ -1,44 +1,197 @@
 #include "Scheduler.hpp"
 #include "ExponentialBackoff.hpp"
+#include "util/util.hpp"
 
+#include <hpx/concurrency/deque.hpp>
 #include <hpx/execution.hpp>
+#include <hpx/thread.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
 
 namespace Workstealing { namespace Scheduler {
 
-void scheduler(hpx::function<void(), false> initialTask) {
-  workstealing::ExponentialBackoff backoff;
+namespace {
 
-  if (!local_policy) {
-    std::cerr << "No local policy set when calling scheduler. Returning\n";
-    return;
-  }
+// Eventcount for idle schedulers: a scheduler reads the epoch before looking
+// for work and only sleeps if no work was added since then
+std::atomic<std::uint64_t> workEpoch(0);
+std::atomic<unsigned> numWaiting(0);
+hpx::mutex idle_mtx;
+hpx::condition_variable work_cv;
+
+// Policies by context slot, accessed with std::atomic_load/store. The Id is
+// kept alongside so a scheduler can run tasks on behalf of the context.
+struct PolicyEntry {
+  YewPar::Context::Id ctx;
+  std::shared_ptr<Policy> policy;
+};
+std::array<std::shared_ptr<const PolicyEntry>, YewPar::Context::maxContexts> policies;
+
+// One past the highest slot that has had a policy, bounds the scheduler scan
+std::atomic<unsigned> numPolicySlots(0);
+
+// Tasks being run by schedulers on this locality, per context slot. Counted
+// before a policy is asked for work so stopSchedulers can wait them out.
+std::array<std::atomic<unsigned>, YewPar::Context::maxContexts> runningTasks {};
+
+struct ContextTask {
+  YewPar::Context::Id ctx;
+  hpx::function<void(), false> task;
+};
+hpx::lockfree::deque<ContextTask> injected;
 
+// Searches using the schedulers, and how many schedulers were started for
+// them. Guarded by lifecycle_mtx, which is held across a whole stop so a new
+// search can't start schedulers while old ones are still exiting.
+hpx::mutex lifecycle_mtx;
+unsigned numUsers = 0;
+unsigned numStarted = 0;
+
+void waitForWork(std::uint64_t seenEpoch, std::chrono::microseconds timeout) {
+  numWaiting++;
   {
-    std::unique_lock<hpx::mutex> l(mtx);
-    numRunningSchedulers++;
+    std::unique_lock<hpx::mutex> l(idle_mtx);
+    if (running && workEpoch.load() == seenEpoch) {
+      work_cv.wait_for(l, timeout);
+    }
+  }
+  numWaiting--;
+}
+
+// Run fn on behalf of ctx on the calling scheduler thread
+template <typename F>
+auto inContext(YewPar::Context::Id ctx, F && fn) {
+  YewPar::Context::Scope scope(ctx);
+  return fn();
+}
+
+// Run task for ctx, then drop it from ctx's running tasks
+hpx::function<void(), false> counted(YewPar::Context::Id ctx, hpx::function<void(), false> task) {
+  return [ctx, task]() {
+    inContext(ctx, task);
+    runningTasks[YewPar::Context::slot(ctx)]--;
+  };
+}
+
+// Look for work over every context, starting from a different one each time
+// so no search is starved
+hpx::function<void(), false> findWork(unsigned & next) {
+  ContextTask ct;
+  if (injected.pop_right(ct)) {
+    runningTasks[YewPar::Context::slot(ct.ctx)]++;
+    return counted(ct.ctx, std::move(ct.task));
+  }
+
+  const auto n = numPolicySlots.load();
+  for (unsigned i = 0; i < n; ++i) {
+    auto e = std::atomic_load(&policies[(next + i) % n]);
+    if (!e) {
+      continue;
+    }
+
+    auto ctx = e->ctx;
+    auto & running = runningTasks[YewPar::Context::slot(ctx)];
+    running++;
+    // Either stopSchedulers sees us counted, or we see its policy cleared
+    if (std::atomic_load(&policies[(next + i) % n]) != e) {
+      running--;
+      continue;
+    }
+
+    auto task = inContext(ctx, [&]() { return e->policy->getWork(); });
+    if (task) {
+      next = (next + i + 1) % n;
+      return counted(ctx, std::move(task));
+    }
+    running--;
   }
+  next = n ? (next + 1) % n : 0;
+  return nullptr;
+}
 
-  // If we are pre-initialised then run that task first then enter the scheduler in this thread
-  if (initialTask) {
-    initialTask();
+void clearPolicy(YewPar::Context::Id ctx) {
+  auto & p = policies[YewPar::Context::slot(ctx)];
+  auto e = std::atomic_load(&p);
+  if (e && e->ctx == ctx) {
+    std::atomic_store(&p, std::shared_ptr<const PolicyEntry>());
   }
+}
+
+}
+
+std::shared_ptr<Policy> getPolicy() {
+  return getPolicy(YewPar::Context::current());
+}
 
+std::shared_ptr<Policy> getPolicy(YewPar::Context::Id ctx) {
+  auto e = std::atomic_load(&policies[YewPar::Context::slot(ctx)]);
+  if (!e || e->ctx != ctx) {
+    return nullptr;
+  }
+  return e->policy;
+}
+
+void setPolicy(YewPar::Context::Id ctx, std::shared_ptr<Policy> policy) {
+  const auto slot = YewPar::Context::slot(ctx);
+  auto e = std::make_shared<const PolicyEntry>(PolicyEntry{ctx, std::move(policy)});
+  std::atomic_store(&policies[slot], std::move(e));
+
+  auto n = numPolicySlots.load();
+  while (n <= slot && !numPolicySlots.compare_exchange_weak(n, slot + 1)) {}
+}
+
+void addTask(hpx::function<void(), false> task) {
+  injected.push_left(ContextTask{YewPar::Context::current(), std::move(task)});
+  notifyWork();
+}
+
+void notifyWork() {
+  workEpoch++;
+  if (numWaiting.load() > 0) {
+    std::lock_guard<hpx::mutex> l(idle_mtx);
+    work_cv.notify_one();
+  }
+}
+
+void scheduler() {
+  workstealing::ExponentialBackoff backoff;
+
+  // Where to start looking for work in the policy table
+  unsigned next = 0;
+
+  bool idle = false;
   for (;;) {
     if (!running) {
       break;
     }
 
-    auto task = local_policy->getWork();
+    auto epoch = workEpoch.load();
+    auto task = findWork(next);
 
     if (task) {
+      if (idle) {
+        numIdleSchedulers--;
+        idle = false;
+      }
       backoff.reset();
       task();
     } else {
+      if (!idle) {
+        numIdleSchedulers++;
+        idle = true;
+      }
       backoff.failed();
-      hpx::this_thread::suspend(backoff.getSleepTime());
+      waitForWork(epoch, backoff.getSleepTime());
     }
   }
 
+  if (idle) {
+    numIdleSchedulers--;
+  }
+
   {
     // Signal exit
     std::unique_lock<hpx::mutex> l(mtx);
@@ -47,8 +200,31 @@ void scheduler(hpx::function<void(), false> initialTask) {
   }
 }
 
-void stopSchedulers() {
+void stopSchedulers(YewPar::Context::Id ctx) {
+  clearPolicy(ctx);
+
+  // Other searches may keep the schedulers running, so ctx's tasks have to be
+  // waited for explicitly
+  auto & running = runningTasks[YewPar::Context::slot(ctx)];
+  while (running.load() > 0) {
+    hpx::this_thread::yield();
+  }
+
+  releaseSchedulers();
+}
+
+void releaseSchedulers() {
+  std::lock_guard<hpx::mutex> lifecycle(lifecycle_mtx);
+  if (numUsers == 0 || --numUsers > 0) {
+    return;
+  }
+
   running.store(false);
+  {
+    // Wake idle schedulers so they see we have stopped
+    std::lock_guard<hpx::mutex> l(idle_mtx);
+    work_cv.notify_all();
+  }
   {
     // Block until all schedulers have finished
     std::unique_lock<hpx::mutex> l(mtx);
@@ -56,16 +232,30 @@ void stopSchedulers() {
       exit_cv.wait(l);
     }
   }
+  numStarted = 0;
 }
 
 void startSchedulers(unsigned n) {
   hpx::execution::parallel_executor exe(hpx::threads::thread_priority::critical,
                                         hpx::threads::thread_stacksize::huge);
 
-  for (auto i = 0; i < n; ++i) {
-    //exe.add(hpx::bind(&scheduler, nullptr));
-    hpx::async(exe, &scheduler, nullptr);
+  std::lock_guard<hpx::mutex> lifecycle(lifecycle_mtx);
+  if (numUsers++ == 0) {
+    running.store(true);
   }
+
+  for (; numStarted < n; ++numStarted) {
+    {
+      // Counted here so a stop straight after waits for it
+      std::unique_lock<hpx::mutex> l(mtx);
+      numRunningSchedulers++;
+    }
+    hpx::async(exe, &scheduler);
+  }
+}
+
+void startLocalSchedulers() {
+  startSchedulers(YewPar::util::getNumWorkers());
 }
 
 }}
@@ -2,12 +2,14 @@
 #define YEWPAR_SCHEDULER_HPP
 
 #include <atomic>
+#include <memory>
 
 #include <hpx/modules/actions_base.hpp>
 #include <hpx/synchronization/mutex.hpp>
 #include <hpx/synchronization/condition_variable.hpp>
 
 #include "policies/Policy.hpp"
+#include "util/Context.hpp"
 
 namespace Workstealing { namespace Scheduler {
 
@@ -18,18 +20,50 @@ hpx::mutex mtx;
 hpx::condition_variable exit_cv;
 unsigned numRunningSchedulers;
 
-// Implementation policy
-std::shared_ptr<Policy> local_policy;
+// Schedulers whose last attempt to find work failed. Lets skeletons decide to
+// split work when there are hungry workers on this locality.
+std::atomic<unsigned> numIdleSchedulers(0);
 
-void stopSchedulers();
+// Implementation policy of each search context on this locality. Schedulers
+// serve every context that has one, so concurrent searches share the workers.
+// Without a context argument these use the calling thread's context.
+std::shared_ptr<Policy> getPolicy();
+std::shared_ptr<Policy> getPolicy(YewPar::Context::Id ctx);
+void setPolicy(YewPar::Context::Id ctx, std::shared_ptr<Policy> policy);
+
+// Schedulers are shared by all searches on a locality: they are started by the
+// first search that needs them and only stopped once the last one finishes.
+// stopSchedulers also removes ctx's policy and returns once none of ctx's
+// tasks are running on this locality.
+void stopSchedulers(YewPar::Context::Id ctx);
 HPX_DEFINE_PLAIN_ACTION(stopSchedulers, stopSchedulers_act);
 
-void scheduler(hpx::function<void(), false> initialTask);
+// Drop one use of the schedulers taken with startSchedulers, without a search
+// context. Lets a driver keep the schedulers running between searches.
+void releaseSchedulers();
+HPX_DEFINE_PLAIN_ACTION(releaseSchedulers, releaseSchedulers_act);
+
+void scheduler();
+
+// Run task on a scheduler, on behalf of the calling thread's context. Used
+// for work that isn't managed by a policy, e.g. initial stacks.
+void addTask(hpx::function<void(), false> task);
 
-// Start "n" uninitialised schedulers
+// Wake an idle scheduler on this locality. Policies call this whenever they
+// make new work available locally so idle schedulers don't have to wait out
+// their backoff. Idle schedulers still poll (with backoff) to find remote work.
+void notifyWork();
+
+// Make sure at least "n" schedulers are running
 void startSchedulers(unsigned n);
 HPX_DEFINE_PLAIN_ACTION(startSchedulers, startSchedulers_act);
 
+// Make sure this locality's own worker count (util::getNumWorkers) of
+// schedulers are running. Broadcast this rather than startSchedulers so
+// localities with different core counts each start the right number.
+void startLocalSchedulers();
+HPX_DEFINE_PLAIN_ACTION(startLocalSchedulers, startLocalSchedulers_act);
+
 }} // Workstealing::Scheduler
 
 
@@ -0,0 +1,153 @@
+#ifndef YEWPAR_STEAL_PREFETCHER_HPP
+#define YEWPAR_STEAL_PREFETCHER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include <hpx/concurrency/deque.hpp>
+#include <hpx/functional/function.hpp>
+#include <hpx/modules/async_distributed.hpp>
+#include <hpx/synchronization/spinlock.hpp>
+
+#include "VictimSelector.hpp"
+
+namespace Workstealing { namespace Scheduler { void notifyWork(); }}
+
+namespace workstealing {
+
+// Asynchronous distributed steals for the queue based policies. Up to
+// maxInFlight steals (to different victims) run at once. Each returns a batch
+// of tasks: the first lands in a local buffer for the next idle worker and the
+// rest go to the local pool, where other workers (or thieves) can take them.
+// No worker ever blocks on the network and policies can start stealing while
+// they still have some local work left.
+//
+// Steal continuations may outlive the policy, so the state they touch is
+// shared with them. StealAction is called on a victim with stealArgs, given
+// at construction, and returns a batch of tasks.
+template <typename StealAction, typename ...StealArgs>
+class StealPrefetcher {
+ public:
+  using funcType = hpx::distributed::function<void(hpx::id_type)>;
+
+  static constexpr unsigned maxInFlight = 4;
+
+ private:
+  struct State {
+    // Guards victims and randGenerator, never held across a steal
+    hpx::spinlock mtx;
+    VictimSelector victims;
+    std::atomic<bool> haveVictims {false};
+    std::mt19937 randGenerator {std::random_device{}()};
+
+    hpx::lockfree::deque<funcType> buffer;
+    std::atomic<unsigned> buffered {0};
+    std::atomic<unsigned> inFlight {0};
+
+    hpx::function<void(funcType), false> addLocal;
+
+    std::atomic<std::uint64_t> & successes;
+    std::atomic<std::uint64_t> & failures;
+
+    std::tuple<StealArgs...> stealArgs;
+
+    State(std::atomic<std::uint64_t> & successes, std::atomic<std::uint64_t> & failures,
+          StealArgs... args)
+        : successes(successes), failures(failures), stealArgs(std::move(args)...) {}
+  };
+
+  std::shared_ptr<State> state;
+
+ public:
+  // Successful/failed steals are counted on the given (perf) counters
+  StealPrefetcher(std::atomic<std::uint64_t> & successes,
+                  std::atomic<std::uint64_t> & failures,
+                  StealArgs... stealArgs)
+      : state(std::make_shared<State>(successes, failures, std::move(stealArgs)...)) {}
+
+  // Where the extra tasks of a batch go, set before stealing starts
+  void setLocalPool(hpx::function<void(funcType), false> addLocal) {
+    state->addLocal = std::move(addLocal);
+  }
+
+  void setVictims(const std::vector<hpx::id_type> & victims) {
+    VictimSelector vs(victims);
+    std::lock_guard<hpx::spinlock> l(state->mtx);
+    state->haveVictims = !vs.empty();
+    state->victims = std::move(vs);
+  }
+
+  // A task from an earlier steal, or nullptr
+  funcType pop() {
+    funcType task;
+    if (state->buffer.pop_right(task)) {
+      state->buffered--;
+      return task;
+    }
+    return nullptr;
+  }
+
+  // Start steals until maxInFlight are running or as many tasks as that are
+  // already buffered. Returns straight away.
+  void prefetch() {
+    auto s = state;
+    if (!s->haveVictims.load()) {
+      return;
+    }
+
+    while (s->buffered.load() + s->inFlight.load() < maxInFlight) {
+      auto n = s->inFlight.load();
+      if (n >= maxInFlight || !s->inFlight.compare_exchange_weak(n, n + 1)) {
+        continue;
+      }
+
+      hpx::id_type victim;
+      {
+        std::lock_guard<hpx::spinlock> l(s->mtx);
+        victim = s->victims.select(s->randGenerator);
+      }
+      if (!victim) {
+        s->inFlight--;
+        return;
+      }
+
+      auto steal = std::apply([&](const auto & ...args) {
+        return hpx::async<StealAction>(victim, args...);
+      }, s->stealArgs);
+
+      steal.then(
+          [s, victim](hpx::future<std::vector<funcType> > f) {
+            std::vector<funcType> tasks;
+            if (!f.has_exception()) {
+              tasks = f.get();
+            }
+
+            {
+              std::lock_guard<hpx::spinlock> l(s->mtx);
+              s->victims.record(victim, !tasks.empty());
+            }
+
+            if (!tasks.empty()) {
+              s->successes++;
+              for (auto i = 1; i < tasks.size(); ++i) {
+                s->addLocal(std::move(tasks[i]));
+              }
+              s->buffered++;
+              s->buffer.push_left(std::move(tasks[0]));
+              Workstealing::Scheduler::notifyWork();
+            } else {
+              s->failures++;
+            }
+            s->inFlight--;
+          });
+    }
+  }
+};
+
+}
+
+#endif
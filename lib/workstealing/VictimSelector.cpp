@@ -0,0 +1,142 @@
+#include "VictimSelector.hpp"
+
+#include <hpx/async_colocated/get_colocation_id.hpp>
+#include <hpx/modules/topology.hpp>
+#include <hpx/resource_partitioner/detail/partitioner.hpp>
+
+#include <algorithm>
+#include <tuple>
+
+#include <unistd.h>
+
+namespace workstealing {
+
+std::string getHostName() {
+  char name[256];
+  if (gethostname(name, sizeof(name)) != 0) {
+    return "";
+  }
+  name[sizeof(name) - 1] = '\0';
+  return name;
+}
+
+VictimSelector::VictimSelector(const std::vector<hpx::id_type> & victims) {
+  std::vector<hpx::future<std::string> > hosts;
+  for (const auto & v : victims) {
+    hosts.push_back(hpx::async<getHostName_act>(hpx::get_colocation_id(hpx::launch::sync, v)));
+  }
+
+  const auto here = getHostName();
+  tiers.resize(2);
+  for (auto i = 0; i < victims.size(); ++i) {
+    auto & tier = hosts[i].get() == here ? tiers[0] : tiers[1];
+    tier.push_back(Victim {victims[i], initialScore});
+  }
+
+  tiers.erase(std::remove_if(tiers.begin(), tiers.end(),
+                             [](const std::vector<Victim> & t) { return t.empty(); }),
+              tiers.end());
+}
+
+bool VictimSelector::empty() const {
+  return tiers.empty();
+}
+
+VictimSelector::Victim * VictimSelector::find(const hpx::id_type & id) {
+  for (auto & t : tiers) {
+    for (auto & v : t) {
+      if (v.id == id) {
+        return &v;
+      }
+    }
+  }
+  return nullptr;
+}
+
+hpx::id_type VictimSelector::select(std::mt19937 & gen, const hpx::id_type & exclude) {
+  std::uniform_real_distribution<double> coin(0, 1);
+
+  for (auto t = 0; t < tiers.size(); ++t) {
+    double best = 0, total = 0;
+    for (const auto & v : tiers[t]) {
+      if (v.id != exclude) {
+        best = std::max(best, v.score);
+        total += v.score;
+      }
+    }
+    if (total == 0) {
+      continue;
+    }
+
+    const bool lastTier = t == tiers.size() - 1;
+    if (!lastTier && coin(gen) >= best) {
+      continue;
+    }
+
+    // Roulette wheel on the success rates
+    auto r = coin(gen) * total;
+    hpx::id_type picked;
+    for (const auto & v : tiers[t]) {
+      if (v.id == exclude) {
+        continue;
+      }
+      picked = v.id;
+      r -= v.score;
+      if (r <= 0) {
+        break;
+      }
+    }
+    return picked;
+  }
+
+  // Everything nearer was skipped and the last tier only holds exclude
+  for (const auto & t : tiers) {
+    for (const auto & v : t) {
+      if (v.id != exclude) {
+        return v.id;
+      }
+    }
+  }
+  return hpx::invalid_id;
+}
+
+void VictimSelector::record(const hpx::id_type & victim, bool success) {
+  if (auto v = find(victim)) {
+    v->score = std::max(minScore, decay * v->score + (1 - decay) * (success ? 1.0 : 0.0));
+  }
+}
+
+std::vector<std::vector<std::size_t> > workerTiers(std::size_t self, std::size_t numWorkers) {
+  std::vector<std::vector<std::size_t> > tiers(4);
+
+  auto & topo = hpx::threads::create_topology();
+  auto & rp   = hpx::resource::get_partitioner();
+
+  auto where = [&](std::size_t worker) {
+    auto pu = rp.get_pu_num(worker);
+    return std::make_tuple(topo.get_core_number(pu),
+                           topo.get_numa_node_number(pu),
+                           topo.get_socket_number(pu));
+  };
+
+  const auto me = where(self);
+  for (auto w = 0; w < numWorkers; ++w) {
+    if (w == self) {
+      continue;
+    }
+    const auto them = where(w);
+    if (std::get<0>(them) == std::get<0>(me)) {
+      tiers[0].push_back(w);
+    } else if (std::get<1>(them) == std::get<1>(me)) {
+      tiers[1].push_back(w);
+    } else if (std::get<2>(them) == std::get<2>(me)) {
+      tiers[2].push_back(w);
+    } else {
+      tiers[3].push_back(w);
+    }
+  }
+
+  return tiers;
+}
+
+}
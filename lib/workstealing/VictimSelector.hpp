@@ -0,0 +1,67 @@
+#ifndef YEWPAR_VICTIM_SELECTOR_HPP
+#define YEWPAR_VICTIM_SELECTOR_HPP
+
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <hpx/modules/actions_base.hpp>
+#include <hpx/modules/runtime_distributed.hpp>
+
+namespace workstealing {
+
+// Chooses steal victims nearest first. Victims are grouped into tiers by
+// distance (e.g. same host, then other hosts) and each victim keeps a decaying
+// success rate from previous steals. A tier is tried with a probability equal
+// to the best success rate in it, and a victim within the tier is picked in
+// proportion to its rate, so empty nearby victims are soon skipped while a
+// victim that just gave us work is tried again first. The last tier is always
+// tried if reached.
+//
+// Not thread safe: policies call this under their own lock or keep one per
+// worker thread.
+class VictimSelector {
+ private:
+  struct Victim {
+    hpx::id_type id;
+    double score;
+  };
+
+  std::vector<std::vector<Victim> > tiers;
+
+  Victim * find(const hpx::id_type & id);
+
+ public:
+  // Rates never drop below minScore so every victim keeps being retried
+  static constexpr double initialScore = 0.5;
+  static constexpr double minScore     = 0.05;
+  static constexpr double decay        = 0.75;
+
+  VictimSelector() = default;
+
+  // Group remote victims (components on other localities) by whether they
+  // run on the same host as us
+  explicit VictimSelector(const std::vector<hpx::id_type> & victims);
+
+  bool empty() const;
+
+  // Returns hpx::invalid_id if there are no victims (other than exclude)
+  hpx::id_type select(std::mt19937 & gen, const hpx::id_type & exclude = hpx::invalid_id);
+
+  // Record the outcome of stealing from victim
+  void record(const hpx::id_type & victim, bool success);
+};
+
+// Other worker threads on this locality grouped nearest first: same core
+// (SMT siblings), same NUMA node, same socket, then everything else. Tiers
+// may be empty.
+std::vector<std::vector<std::size_t> > workerTiers(std::size_t self, std::size_t numWorkers);
+
+// Name of the host this locality runs on
+std::string getHostName();
+HPX_DEFINE_PLAIN_ACTION(getHostName, getHostName_act);
+
+}
+
+#endif
@@ -1,5 +1,7 @@
 #include "Workqueue.hpp"
 
+#include <algorithm>
+
 namespace workstealing
 {
   using funcType = Workqueue::funcType;
@@ -9,18 +11,33 @@ namespace workstealing
     if (!tasks.pop_right(task)) {
       return nullptr;
     }
+    count--;
     return task;
   }
 
+  std::vector<funcType> Workqueue::stealBatch() {
+    const std::size_t n = std::min(maxStealBatch, std::max<std::int64_t>(1, count.load() / 2));
+
+    std::vector<funcType> res;
+    funcType task;
+    while (res.size() < n && tasks.pop_right(task)) {
+      count--;
+      res.push_back(std::move(task));
+    }
+    return res;
+  }
+
   funcType Workqueue::getLocal() {
     funcType task;
     if (!tasks.pop_left(task)) {
       return nullptr;
     }
+    count--;
     return task;
   }
 
   void Workqueue::addWork(funcType task) {
+    count++;
     tasks.push_left(task);
   }
 }
@@ -32,4 +49,5 @@ HPX_REGISTER_COMPONENT(Workqueue_type, Workqueue);
 
 HPX_REGISTER_ACTION(workstealing::Workqueue::getLocal_action, Workqueue_getLocal_action);
 HPX_REGISTER_ACTION(workstealing::Workqueue::steal_action, Workqueue_steal_action);
+HPX_REGISTER_ACTION(workstealing::Workqueue::stealBatch_action, Workqueue_stealBatch_action);
 HPX_REGISTER_ACTION(workstealing::Workqueue::addWork_action, Workqueue_addWork_action);
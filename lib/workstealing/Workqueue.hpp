@@ -1,6 +1,10 @@
 #ifndef WORKQUEUE_COMPONENT_HPP
 #define WORKQUEUE_COMPONENT_HPP
 
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
 #include <hpx/include/components.hpp>
 #include <hpx/concurrency/deque.hpp>
 #include <hpx/functional/function.hpp>
@@ -15,16 +19,26 @@ namespace workstealing
       HPX_DEFINE_COMPONENT_ACTION(Workqueue, getLocal);
       funcType steal();
       HPX_DEFINE_COMPONENT_ACTION(Workqueue, steal);
+      // Steal half the queued tasks (at least one, at most maxStealBatch)
+      std::vector<funcType> stealBatch();
+      HPX_DEFINE_COMPONENT_ACTION(Workqueue, stealBatch);
       void addWork(funcType task);
       HPX_DEFINE_COMPONENT_ACTION(Workqueue, addWork);
 
+      // Approximate number of queued tasks (local use only)
+      std::int64_t size() const { return count.load(std::memory_order_relaxed); }
+
+      static constexpr std::int64_t maxStealBatch = 32;
+
     private:
       hpx::lockfree::deque<funcType> tasks; // From HPX
+      std::atomic<std::int64_t> count {0};
     };
 }
 
 HPX_REGISTER_ACTION_DECLARATION(workstealing::Workqueue::getLocal_action, Workqueue_getLocal_action);
 HPX_REGISTER_ACTION_DECLARATION(workstealing::Workqueue::steal_action, Workqueue_steal_action);
+HPX_REGISTER_ACTION_DECLARATION(workstealing::Workqueue::stealBatch_action, Workqueue_stealBatch_action);
 HPX_REGISTER_ACTION_DECLARATION(workstealing::Workqueue::addWork_action, Workqueue_addWork_action);
 
 #endif
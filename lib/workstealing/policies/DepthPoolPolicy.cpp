@@ -64,70 +64,58 @@ void registerPerformanceCounters() {
 
 }
 
-DepthPoolPolicy::DepthPoolPolicy(hpx::id_type workpool) {
+DepthPoolPolicy::DepthPoolPolicy(hpx::id_type workpool)
+    : remote(DepthPoolPolicyPerf::perf_distributedSteals, DepthPoolPolicyPerf::perf_failedDistributedSteals) {
   local_workpool = workpool;
-  last_remote = hpx::find_here();
-
-  std::random_device rd;
-  randGenerator.seed(rd());
+  local_workpool_ptr = hpx::get_ptr<workstealing::DepthPool>(hpx::launch::sync, workpool);
+  // The victim's shallowest tasks, so they stay first in line to be stolen on
+  remote.setLocalPool([p = local_workpool_ptr](auto t) { p->addWork(std::move(t), 0); });
 }
 
 hpx::function<void(), false> DepthPoolPolicy::getWork() {
-  std::unique_lock<mutex_t> l(mtx);
-
   hpx::distributed::function<void(hpx::id_type)> task;
-  task = hpx::async<workstealing::DepthPool::getLocal_action>(local_workpool).get();
+  task = local_workpool_ptr->getLocal();
 
   if (task) {
     DepthPoolPolicyPerf::perf_localSteals++;
+
+    // Running low, overlap remote steals with the work we have left
+    if (local_workpool_ptr->size() < lowWater) {
+      remote.prefetch();
+    }
     return hpx::bind(task, hpx::find_here());
   } else {
     DepthPoolPolicyPerf::perf_failedLocalSteals++;
   }
 
-  if (!distributed_workpools.empty()) {
-    // Last steal optimisation
-    if (last_remote != hpx::find_here()) {
-      task = hpx::async<workstealing::DepthPool::steal_action>(last_remote).get();
-      if (task) {
-        DepthPoolPolicyPerf::perf_distributedSteals++;
-        return hpx::bind(task, hpx::find_here());
-      } else {
-        DepthPoolPolicyPerf::perf_failedDistributedSteals++;
-        last_remote = hpx::find_here();
-      }
-    }
-
-    // If we fail the last steal then we try else where
-    std::uniform_int_distribution<int> rand(0, distributed_workpools.size() - 1);
-    auto victim = distributed_workpools.begin();
-    std::advance(victim, rand(randGenerator));
-    task = hpx::async<workstealing::DepthPool::steal_action>(*victim).get();
-
-    if (task) {
-      last_remote = *victim;
-      DepthPoolPolicyPerf::perf_distributedSteals++;
-      return hpx::bind(task, hpx::find_here());
-    } else {
-      DepthPoolPolicyPerf::perf_failedDistributedSteals++;
-    }
+  task = remote.pop();
+  remote.prefetch();
+  if (task) {
+    return hpx::bind(task, hpx::find_here());
   }
 
   return nullptr;
 }
 
 void DepthPoolPolicy::addwork(hpx::distributed::function<void(hpx::id_type)> task, unsigned depth) {
-  std::unique_lock<mutex_t> l(mtx);
   DepthPoolPolicyPerf::perf_spawns++;
-  hpx::post<workstealing::DepthPool::addWork_action>(local_workpool, task, depth);
+  local_workpool_ptr->addWork(std::move(task), depth);
+  Workstealing::Scheduler::notifyWork();
 }
 
 void DepthPoolPolicy::registerDistributedDepthPools(std::vector<hpx::id_type> workpools) {
-  std::unique_lock<mutex_t> l(mtx);
-  distributed_workpools = workpools;
-  distributed_workpools .erase(
-      std::remove_if(distributed_workpools.begin(), distributed_workpools.end(), YewPar::util::isColocated),
-      distributed_workpools.end());
+  workpools.erase(
+      std::remove_if(workpools.begin(), workpools.end(), YewPar::util::isColocated),
+      workpools.end());
+
+  remote.setVictims(workpools);
+}
+
+std::tuple<std::uint64_t, std::uint64_t, std::uint64_t> DepthPoolPolicy::getLoadCounters() {
+  using namespace DepthPoolPolicyPerf;
+  return std::make_tuple(perf_spawns.load(),
+                         perf_localSteals.load() + perf_distributedSteals.load(),
+                         perf_failedLocalSteals.load() + perf_failedDistributedSteals.load());
 }
 
 }}
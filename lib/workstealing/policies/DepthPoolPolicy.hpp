@@ -8,11 +8,18 @@
 #include <hpx/runtime_distributed/find_all_localities.hpp>
 
 #include "../DepthPool.hpp"
+#include "../StealPrefetcher.hpp"
+#include "util/Context.hpp"
 
-#include <random>
+#include <cstdint>
+#include <tuple>
 #include <vector>
 
-namespace Workstealing { namespace Scheduler {extern std::shared_ptr<Policy> local_policy; }}
+namespace Workstealing { namespace Scheduler {
+std::shared_ptr<Policy> getPolicy(YewPar::Context::Id ctx);
+void setPolicy(YewPar::Context::Id ctx, std::shared_ptr<Policy> policy);
+void notifyWork();
+}}
 
 namespace Workstealing { namespace Policies {
 
@@ -26,14 +33,14 @@ class DepthPoolPolicy : public Policy {
 
  private:
   hpx::id_type local_workpool;
-  hpx::id_type last_remote;
-  std::vector<hpx::id_type> distributed_workpools;
-
-  // random number generator
-  std::mt19937 randGenerator;
+  // The local pool is always colocated so we call it directly. Actions are
+  // only used for remote victims.
+  std::shared_ptr<workstealing::DepthPool> local_workpool_ptr;
+  // Remote queues are stolen from asynchronously into a local buffer
+  workstealing::StealPrefetcher<workstealing::DepthPool::stealBatch_action> remote;
 
-  using mutex_t = hpx::mutex;
-  mutex_t mtx;
+  // Start stealing remotely once the local queue holds fewer tasks than this
+  static constexpr std::int64_t lowWater = 2;
 
  public:
   DepthPoolPolicy(hpx::id_type workpool);
@@ -45,32 +52,38 @@ class DepthPoolPolicy : public Policy {
 
   void registerDistributedDepthPools(std::vector<hpx::id_type> workpools);
 
-  static void setDepthPool(hpx::id_type localworkpool) {
-    Workstealing::Scheduler::local_policy = std::make_shared<DepthPoolPolicy>(localworkpool);
+  // (spawns, successful steals, failed steals) on this locality since the
+  // counters were last reset. Lets skeletons tune task granularity to load.
+  static std::tuple<std::uint64_t, std::uint64_t, std::uint64_t> getLoadCounters();
+
+  static void setDepthPool(YewPar::Context::Id ctx, hpx::id_type localworkpool) {
+    Workstealing::Scheduler::setPolicy(ctx, std::make_shared<DepthPoolPolicy>(localworkpool));
   }
   struct setDepthPool_act : hpx::actions::make_action<
     decltype(&DepthPoolPolicy::setDepthPool),
     &DepthPoolPolicy::setDepthPool,
     setDepthPool_act>::type {};
 
-  static void setDistributedDepthPools(std::vector<hpx::id_type> workpools) {
-    std::static_pointer_cast<Workstealing::Policies::DepthPoolPolicy>(Workstealing::Scheduler::local_policy)->registerDistributedDepthPools(workpools);
+  static void setDistributedDepthPools(YewPar::Context::Id ctx, std::vector<hpx::id_type> workpools) {
+    std::static_pointer_cast<Workstealing::Policies::DepthPoolPolicy>(Workstealing::Scheduler::getPolicy(ctx))->registerDistributedDepthPools(workpools);
   }
   struct setDistributedDepthPools_act : hpx::actions::make_action<
     decltype(&DepthPoolPolicy::setDistributedDepthPools),
     &DepthPoolPolicy::setDistributedDepthPools,
     setDistributedDepthPools_act>::type {};
 
+  // Set up the policy for the calling thread's search context
   static void initPolicy() {
+    const auto ctx = YewPar::Context::current();
     std::vector<hpx::future<void> > futs;
     std::vector<hpx::id_type> pools;
     for (auto const& loc : hpx::find_all_localities()) {
       auto depthpool = hpx::new_<workstealing::DepthPool>(loc).get();
-      futs.push_back(hpx::async<setDepthPool_act>(loc, depthpool));
+      futs.push_back(hpx::async<setDepthPool_act>(loc, ctx, depthpool));
       pools.push_back(depthpool);
     }
     hpx::wait_all(futs);
-    hpx::wait_all(hpx::lcos::broadcast<setDistributedDepthPools_act>(hpx::find_all_localities(), pools));
+    hpx::wait_all(hpx::lcos::broadcast<setDistributedDepthPools_act>(hpx::find_all_localities(), ctx, pools));
   }
 };
 
@@ -0,0 +1,89 @@
+#ifndef YEWPAR_POLICY_HYBRID_HPP
+#define YEWPAR_POLICY_HYBRID_HPP
+
+#include <memory>
+#include <vector>
+
+#include <hpx/include/components.hpp>
+#include <hpx/modules/collectives.hpp>
+#include <hpx/runtime_distributed/find_all_localities.hpp>
+
+#include "Policy.hpp"
+#include "DepthPoolPolicy.hpp"
+#include "SearchManager.hpp"
+
+namespace Workstealing { namespace Policies {
+
+// Tasks spawned above the cutoff live in a DepthPool, as in DepthBounded,
+// while tasks below the cutoff register their generator stacks with a
+// SearchManager. Once the depth pools (local and remote) are empty idle
+// workers fall back to stealing directly from running subtrees.
+//
+// The policy is a SearchManagerComp so the existing SearchManager actions
+// (which cast the local policy) keep working for steals between localities.
+template <typename SearchInfo, typename FuncToCall, typename ...Args>
+class HybridPolicy : public SearchManager::SearchManagerComp<SearchInfo, FuncToCall, Args...> {
+ private:
+  using SearchManagerT = SearchManager::SearchManagerComp<SearchInfo, FuncToCall, Args...>;
+
+  DepthPoolPolicy depthPool;
+
+ public:
+  HybridPolicy(YewPar::Context::Id ctx, hpx::id_type workpool) : SearchManagerT(ctx), depthPool(workpool) {}
+
+  hpx::function<void(), false> getWork() override {
+    auto task = depthPool.getWork();
+    if (task) {
+      return task;
+    }
+    return SearchManagerT::getWork();
+  }
+
+  void addwork(hpx::distributed::function<void(hpx::id_type)> task, unsigned depth) {
+    depthPool.addwork(task, depth);
+  }
+
+  static void setPolicy(YewPar::Context::Id ctx, hpx::id_type localworkpool) {
+    Workstealing::Scheduler::setPolicy(ctx, std::make_shared<HybridPolicy>(ctx, localworkpool));
+  }
+  struct setPolicy_act : hpx::actions::make_action<
+    decltype(&HybridPolicy::setPolicy),
+    &HybridPolicy::setPolicy,
+    setPolicy_act>::type {};
+
+  static void setDistributedDepthPools(YewPar::Context::Id ctx, std::vector<hpx::id_type> workpools) {
+    std::static_pointer_cast<HybridPolicy>(Workstealing::Scheduler::getPolicy(ctx))->depthPool.registerDistributedDepthPools(workpools);
+  }
+  struct setDistributedDepthPools_act : hpx::actions::make_action<
+    decltype(&HybridPolicy::setDistributedDepthPools),
+    &HybridPolicy::setDistributedDepthPools,
+    setDistributedDepthPools_act>::type {};
+
+  // Set up the policy for the calling thread's search context
+  static void initPolicy() {
+    const auto ctx = YewPar::Context::current();
+    std::vector<hpx::future<void> > futs;
+    std::vector<hpx::id_type> pools;
+    std::vector<hpx::id_type> searchManagers;
+    for (auto const& loc : hpx::find_all_localities()) {
+      auto depthpool = hpx::new_<workstealing::DepthPool>(loc).get();
+      futs.push_back(hpx::async<setPolicy_act>(loc, ctx, depthpool));
+      pools.push_back(depthpool);
+
+      // Only used as an address for remote steals, the policy itself is set above
+      searchManagers.push_back(hpx::new_<SearchManager>(loc).get());
+    }
+    hpx::wait_all(futs);
+
+    hpx::wait_all(hpx::lcos::broadcast<setDistributedDepthPools_act>(hpx::find_all_localities(), ctx, pools));
+
+    for (auto const & mgr : searchManagers) {
+      using act = typename SearchManager::RegisterDistributedManagersAct<SearchInfo, FuncToCall, Args...>;
+      hpx::async<act>(mgr, ctx, searchManagers).get();
+    }
+  }
+};
+
+}}
+
+#endif
@@ -6,8 +6,14 @@
 
 #include "Policy.hpp"
 #include "workstealing/PriorityWorkqueue.hpp"
+#include "util/util.hpp"
+#include "util/Context.hpp"
 
-namespace Workstealing { namespace Scheduler {extern std::shared_ptr<Policy> local_policy; }}
+namespace Workstealing { namespace Scheduler {
+std::shared_ptr<Policy> getPolicy(YewPar::Context::Id ctx);
+void setPolicy(YewPar::Context::Id ctx, std::shared_ptr<Policy> policy);
+void notifyWork();
+}}
 
 namespace Workstealing { namespace Policies {
 
@@ -26,18 +32,29 @@ class PriorityOrderedPolicy : public Policy {
  private:
   hpx::id_type globalWorkqueue;
 
+  // Set on the locality holding the global workqueue, which calls it directly
+  // rather than through actions
+  std::shared_ptr<workstealing::PriorityWorkqueue> localWorkqueue;
+
   using mutex_t = hpx::mutex;
   mutex_t mtx;
 
  public:
-  PriorityOrderedPolicy (hpx::id_type gWorkqueue) : globalWorkqueue(gWorkqueue) {};
+  PriorityOrderedPolicy (hpx::id_type gWorkqueue) : globalWorkqueue(gWorkqueue) {
+    if (YewPar::util::isColocated(globalWorkqueue)) {
+      localWorkqueue = hpx::get_ptr<workstealing::PriorityWorkqueue>(hpx::launch::sync, globalWorkqueue);
+    }
+  };
 
   // Priority Ordered policy just forwards requests to the global workqueue
   hpx::function<void(), false> getWork() override {
-    std::unique_lock<mutex_t> l(mtx);
-
     hpx::distributed::function<void(hpx::id_type)> task;
-    task = hpx::async<workstealing::PriorityWorkqueue::steal_action>(globalWorkqueue).get();
+    if (localWorkqueue) {
+      task = localWorkqueue->steal();
+    } else {
+      std::unique_lock<mutex_t> l(mtx);
+      task = hpx::async<workstealing::PriorityWorkqueue::steal_action>(globalWorkqueue).get();
+    }
     if (task) {
       PriorityOrderedPerf::perf_steals++;
       return hpx::bind(task, hpx::find_here());
@@ -48,29 +65,38 @@ class PriorityOrderedPolicy : public Policy {
   }
 
   void addwork(int priority, hpx::distributed::function<void(hpx::id_type)> task) {
-    std::unique_lock<mutex_t> l(mtx);
     PriorityOrderedPerf::perf_spawns++;
+    if (localWorkqueue) {
+      localWorkqueue->addWork(priority, std::move(task));
+      Workstealing::Scheduler::notifyWork();
+      return;
+    }
+    std::unique_lock<mutex_t> l(mtx);
     hpx::post<workstealing::PriorityWorkqueue::addWork_action>(globalWorkqueue, priority, task);
   }
 
   hpx::future<bool> workRemaining() {
+    if (localWorkqueue) {
+      return hpx::make_ready_future(localWorkqueue->workRemaining());
+    }
     std::unique_lock<mutex_t> l(mtx);
     return hpx::async<workstealing::PriorityWorkqueue::workRemaining_action>(globalWorkqueue);
   }
 
   // Policy initialiser
-  static void setPriorityWorkqueuePolicy(hpx::id_type globalWorkqueue) {
-    Workstealing::Scheduler::local_policy = std::make_shared<PriorityOrderedPolicy>(globalWorkqueue);
+  static void setPriorityWorkqueuePolicy(YewPar::Context::Id ctx, hpx::id_type globalWorkqueue) {
+    Workstealing::Scheduler::setPolicy(ctx, std::make_shared<PriorityOrderedPolicy>(globalWorkqueue));
   }
   struct setPriorityWorkqueuePolicy_act : hpx::actions::make_action<
     decltype(&PriorityOrderedPolicy::setPriorityWorkqueuePolicy),
     &PriorityOrderedPolicy::setPriorityWorkqueuePolicy,
     setPriorityWorkqueuePolicy_act>::type {};
 
+  // Set up the policy for the calling thread's search context
   static void initPolicy () {
     auto globalWorkqueue = hpx::new_<workstealing::PriorityWorkqueue>(hpx::find_here()).get();
     hpx::wait_all(hpx::lcos::broadcast<setPriorityWorkqueuePolicy_act>(
-        hpx::find_all_localities(), globalWorkqueue));
+        hpx::find_all_localities(), YewPar::Context::current(), globalWorkqueue));
   }
 };
 
@@ -1,25 +1,31 @@
 #ifndef YEWPAR_SEARCHMANAGER_COMPONENT_HPP
 #define YEWPAR_SEARCHMANAGER_COMPONENT_HPP
 
-#include <iterator>                                              // for advance
+#include <algorithm>
 #include <memory>                                                // for allo...
 #include <random>                                                // for defa...
 #include <vector>                                                // for vector
 #include <utility>                                               // for vector
-#include <queue>
 #include <atomic>
-#include <unordered_map>
 
 #include <hpx/include/components.hpp>
 
 #include <hpx/performance_counters/manage_counter_type.hpp>
 #include <hpx/lcos_local/channel.hpp>
 #include <hpx/concurrency/deque.hpp>
+#include <hpx/synchronization/spinlock.hpp>
+#include <hpx/thread.hpp>
 
 #include "Policy.hpp"
 #include "util/util.hpp"
+#include "util/Context.hpp"
+#include "workstealing/VictimSelector.hpp"
 
-namespace Workstealing { namespace Scheduler {extern std::shared_ptr<Policy> local_policy; }}
+namespace Workstealing { namespace Scheduler {
+std::shared_ptr<Policy> getPolicy(YewPar::Context::Id ctx);
+void setPolicy(YewPar::Context::Id ctx, std::shared_ptr<Policy> policy);
+void notifyWork();
+}}
 
 namespace Workstealing { namespace Policies {
 
@@ -46,6 +52,18 @@ HPX_DEFINE_PLAIN_ACTION(printChunkSizeList, printChunkSizeList_act);
 
 namespace Workstealing { namespace Policies {
 
+// A search stack that thieves can take work from directly, without waiting
+// for the thread running it to answer a steal request (see
+// StackStealing::PassiveStack)
+template <typename SearchInfo>
+struct StealableStack {
+  virtual ~StealableStack() = default;
+
+  // Claim an unexplored node, returning false if there is nothing to steal.
+  // Must not block.
+  virtual bool trySteal(SearchInfo & info, int & depth) = 0;
+};
+
 // The SearchManager component allows steals to happen directly within a
 // searching thread. The SearchManager maintains a list of active threads and
 // uses this to perform steals when work is requested from the scheduler. Thread
@@ -62,8 +80,8 @@ struct SearchManager : public hpx::components::component_base<SearchManager> {
   // std::shared_ptr<void> ptr;
 
   template <typename SearchInfo, typename FuncToCall, typename ...Args>
-  void init() {
-    Workstealing::Scheduler::local_policy = std::make_shared<SearchManagerComp<SearchInfo, FuncToCall, Args...> >();
+  void init(YewPar::Context::Id ctx) {
+    Workstealing::Scheduler::setPolicy(ctx, std::make_shared<SearchManagerComp<SearchInfo, FuncToCall, Args...> >(ctx));
   }
 
   template <typename SearchInfo, typename FuncToCall, typename ...Args>
@@ -86,84 +104,198 @@ struct SearchManager : public hpx::components::component_base<SearchManager> {
     // Information shared between a thread and the manager. We set the atomic on a steal and then use the channel to await a response
     using SharedState = std::tuple<std::atomic<bool>, hpx::lcos::local::one_element_channel<Response>, bool>;
 
-    // Lock to protect the component
-    using MutexT = hpx::mutex;
-    MutexT mtx;
+    // Running threads live in a fixed array of slots, one claimed per
+    // registered thread. A thief claims an Active slot by moving it to
+    // Stealing, so at most one steal runs per victim without any shared lock.
+    // If the owner unregisters mid steal it marks the slot Cancelled and the
+    // thief frees it once done.
+    enum SlotState : unsigned { Free, Claimed, Active, Stealing, Cancelled };
+
+    struct alignas(64) Slot {
+      std::atomic<unsigned> state {Free};
+
+      // Only written while the slot is Claimed, read by a thief while it holds
+      // the slot in Stealing
+      std::shared_ptr<SharedState> stealReq;
+      std::shared_ptr<StealableStack<SearchInfo> > stack;
+    };
+
+    // The search context this manager works for
+    YewPar::Context::Id ctx;
+
+    unsigned numSlots;
+    std::unique_ptr<Slot[]> slots;
 
-    // (internal) Id's of currently running threads, for managing the active map
-    std::queue<unsigned> activeIds;
+    // Registered threads, approximate
+    std::atomic<unsigned> numActive {0};
 
-    // Active thread shared states
-    std::unordered_map<unsigned, std::shared_ptr<SharedState> > active;
+    // Protects the distributed steal state below, never taken on a local steal
+    using MutexT = hpx::mutex;
+    MutexT mtx;
 
-    // Shared states of threads currently being stolen from
-    std::unordered_map<unsigned, std::shared_ptr<SharedState> > inactive;
+    // Protects the SearchManagerPerf lists
+    hpx::spinlock statsMtx;
 
     // Pointers to SearchManagers on other localities
     std::vector<hpx::id_type> distributedSearchManagers;
 
-    // random number generator
+    // random number generator (for distributed victims)
     std::mt19937 randGenerator;
 
-    // Are we currently doing a distributed steal?
-    bool isStealingDistributed = false;
+    static std::mt19937 & threadRandGenerator() {
+      static thread_local std::mt19937 gen(std::random_device{}());
+      return gen;
+    }
+
+    // Distributed steals currently in flight
+    unsigned distributedStealsInFlight = 0;
+    static constexpr unsigned maxDistributedSteals = 2;
 
     // Task Buffer for chunking
     hpx::lockfree::deque<Task> taskBuffer;
 
-    // Last steal optimisation
-    hpx::id_type last_remote;
+    // Remote SearchManagers, nearest and most productive first. Fed the same
+    // outcomes as distributedStealsList.
+    workstealing::VictimSelector victims;
 
-    // Try to steal from a thread on another (random) locality
-    Response tryDistributedSteal(std::unique_lock<MutexT> & l) {
-      // We only allow one distributed steal to happen at a time (to make sure we
-      // don't overload the communication)
-      if (isStealingDistributed) {
-        return {};
+    // Start a steal from a thread on another locality (nearest first) unless
+    // enough are already in flight. Stolen tasks are queued in taskBuffer when
+    // they arrive so no worker waits on the network.
+    void startDistributedSteal() {
+      hpx::id_type victim;
+      {
+        std::lock_guard<MutexT> l(mtx);
+        if (distributedStealsInFlight >= maxDistributedSteals) {
+          return;
+        }
+
+        victim = victims.select(randGenerator);
+        if (!victim) {
+          return;
+        }
+        ++distributedStealsInFlight;
       }
 
-      isStealingDistributed = true;
+      // The continuation keeps the policy alive
+      auto self = std::static_pointer_cast<SearchManagerComp>(Workstealing::Scheduler::getPolicy(ctx));
+      hpx::async<GetDistributedWorkAct<SearchInfo, FuncToCall, Args...> >(victim, ctx).then(
+          [self, victim](hpx::future<Response> f) {
+            Response res;
+            if (!f.has_exception()) {
+              res = f.get();
+            }
+            self->receiveDistributedSteal(victim, std::move(res));
+          });
+    }
 
-      // Last steal optimisation
-      hpx::id_type victim;
-      if (last_remote != hpx::find_here()) {
-        victim = last_remote;
-      } else {
-        auto vic = distributedSearchManagers.begin();
+    void receiveDistributedSteal(const hpx::id_type & victim, Response res) {
+      {
+        std::lock_guard<MutexT> l(mtx);
+        --distributedStealsInFlight;
+        victims.record(victim, !res.empty());
+      }
+
+      {
+        std::lock_guard<hpx::spinlock> l(statsMtx);
+        SearchManagerPerf::distributedStealsList.push_back(std::make_pair(victim, !res.empty()));
+        if (!res.empty()) {
+          SearchManagerPerf::chunkSizeList.emplace_back(res.size());
+        }
+      }
+
+      if (res.empty()) {
+        SearchManagerPerf::perf_failedDistributedSteals++;
+        return;
+      }
+
+      SearchManagerPerf::perf_distributedSteals++;
+      for (auto & t : res) {
+        taskBuffer.push_left(std::move(t));
+      }
+      Workstealing::Scheduler::notifyWork();
+    }
+
+   public:
+
+    // Claim a free slot, preferring our own worker's so claims rarely collide
+    unsigned claimSlot() {
+      const unsigned start = std::min<std::size_t>(hpx::get_worker_thread_num(), numSlots - 1);
+      for (;;) {
+        for (unsigned i = 0; i < numSlots; ++i) {
+          auto id = (start + i) % numSlots;
+          unsigned expected = Free;
+          if (slots[id].state.load() == Free &&
+              slots[id].state.compare_exchange_strong(expected, Claimed)) {
+            return id;
+          }
+        }
+        // Every slot is taken, wait for a thief to hand one back
+        hpx::this_thread::yield();
+      }
+    }
+
+    void releaseSlot(Slot & slot) {
+      slot.stealReq.reset();
+      slot.stack.reset();
+      slot.state.store(Free);
+    }
 
-        std::uniform_int_distribution<> rand(0, distributedSearchManagers.size() - 1);
-        std::advance(vic, rand(randGenerator));
-        victim = *vic;
+    // Called by the thief holding slot in Stealing when it is done with it
+    void endSteal(Slot & slot) {
+      unsigned expected = Stealing;
+      if (!slot.state.compare_exchange_strong(expected, Active)) {
+        // The owner finished during the steal and left the slot to us
+        releaseSlot(slot);
       }
+    }
 
-      l.unlock();
-      auto res = hpx::async<GetDistributedWorkAct<SearchInfo, FuncToCall, Args...> >(victim).get();
-      l.lock();
+    // Steal from a slot we moved to Stealing
+    Response stealFrom(Slot & slot) {
+      // Take work straight off a passive stack, the victim keeps running
+      if (slot.stack) {
+        auto stack = slot.stack;
+        endSteal(slot);
+
+        SearchInfo info;
+        int depth;
+        if (stack->trySteal(info, depth)) {
+          return {hpx::make_tuple(std::move(info), depth, hpx::invalid_id)};
+        }
+        return {};
+      }
 
-      isStealingDistributed = false;
+      auto stealReq = slot.stealReq;
 
-      if (!res.empty()) {
-        SearchManagerPerf::distributedStealsList.push_back(std::make_pair(victim, true));
-        last_remote = victim;
+      // Signal the thread that we need work from it and wait for some (or
+      // Nothing). Whichever of us and a finishing owner clears the flag first
+      // knows no answer was sent.
+      Response res;
+      std::get<0>(*stealReq).store(true);
+      if (slot.state.load() == Cancelled && std::get<0>(*stealReq).exchange(false)) {
+        res = {};
       } else {
-        SearchManagerPerf::distributedStealsList.push_back(std::make_pair(victim, false));
-        last_remote = hpx::find_here();
+        res = std::get<1>(*stealReq).get().get();
       }
 
+      endSteal(slot);
+
+      // -1 depth signals that the thread we tried to steal from has finished it's search
+      if (!res.empty() && hpx::get<1>(res[0]) == -1) {
+        return {};
+      }
       return res;
     }
 
    public:
 
-    SearchManagerComp() {
-      for (auto i = 0; i < hpx::get_os_thread_count(); ++i) {
-        activeIds.push(i);
-      }
-
+    SearchManagerComp(YewPar::Context::Id ctx)
+        : ctx(ctx),
+          // One extra slot for a master thread running a stack alongside the
+          // workers
+          numSlots(hpx::get_os_thread_count() + 1),
+          slots(new Slot[numSlots]) {
       std::random_device rd;
       randGenerator.seed(rd());
-
-      last_remote = hpx::find_here();
     }
 
     // Notify this search manager of the globalId's of potential steal victims
@@ -173,82 +305,58 @@ struct SearchManager : public hpx::components::component_base<SearchManager> {
       distributedSearchManagers.erase(
           std::remove_if(distributedSearchManagers.begin(), distributedSearchManagers.end(), YewPar::util::isColocated),
           distributedSearchManagers.end());
+      victims = workstealing::VictimSelector(distributedSearchManagers);
     }
 
     // Try to get work from a (random) thread running on this locality and wrap it
     // back up for serializing over the network
     Response getDistributedWork() {
-      std::unique_lock<MutexT> l(mtx);
-      return getLocalWork(l);
+      return getLocalWork();
     }
 
-    // Try to get work from a (random) thread running on this locality
-    Response getLocalWork(std::unique_lock<MutexT> & l) {
-      if (active.empty()) {
+    // Try to get work from a (random) thread running on this locality. Probes
+    // slots from a random start, so finding a victim takes O(1) expected time
+    // while most workers are busy.
+    Response getLocalWork() {
+      if (numActive.load() == 0) {
         return {};
       }
-      auto victim = active.begin();
-
-      std::uniform_int_distribution<> rand(0, active.size() - 1);
-      std::advance(victim, rand(randGenerator));
-
-      auto pos         = victim->first;
-      auto stealReqPtr = victim->second;
 
-      // We remove the victim from active while we steal, so that if we suspend
-      // no other thread gets in the way of our steal
-      active.erase(pos);
-      inactive[pos] = stealReqPtr;
-
-      // Signal the thread that we need work from it and wait for some (or Nothing)
-      //std::get<2>(*stealReqPtr) = true;
-      std::get<0>(*stealReqPtr).store(true);
-
-      auto resF = std::get<1>(*stealReqPtr).get();
-      l.unlock();
-      auto res = resF.get();
-      l.lock();
-
-      // -1 depth signals that the thread we tried to steal from has finished it's search
-      if (!res.empty() && hpx::get<1>(res[0]) == -1) {
-        return {};
+      std::uniform_int_distribution<unsigned> rand(0, numSlots - 1);
+      const auto start = rand(threadRandGenerator());
+      for (unsigned i = 0; i < numSlots; ++i) {
+        auto & slot = slots[(start + i) % numSlots];
+        unsigned expected = Active;
+        if (slot.state.load() == Active &&
+            slot.state.compare_exchange_strong(expected, Stealing)) {
+          return stealFrom(slot);
+        }
       }
-
-      // Allow this thread to be stolen from again
-      active[pos] = stealReqPtr;
-      inactive.erase(pos);
-      return res;
+      return {};
     }
 
     // Called by the scheduler to ask the searchManager to add more work
     hpx::function<void(), false> getWork() override {
-      std::unique_lock<MutexT> l(mtx);
-
       // Return from task buffer first if anything exists
       Task task;
       if (taskBuffer.pop_right(task)) {
         SearchInfo searchInfo; int depth; hpx::id_type prom;
         hpx::tie(searchInfo, depth, prom) = task;
-        return hpx::bind(FuncToCall::fn_ptr(), searchInfo, depth, prom);
+        return hpx::bind(FuncToCall::fn_ptr(), ctx, searchInfo, depth, prom);
       }
 
       Response maybeStolen;
-      if (active.empty()) {
-        // No local threads running, steal distributed
+      if (numActive.load() == 0) {
+        // No local threads running, steal distributed. The result (if any)
+        // arrives in taskBuffer later.
         if (!distributedSearchManagers.empty()) {
-          maybeStolen = tryDistributedSteal(l);
-          if (!maybeStolen.empty()) {
-            SearchManagerPerf::perf_distributedSteals++;
-          } else {
-            SearchManagerPerf::perf_failedDistributedSteals++;
-            return nullptr;
-          }
+          startDistributedSteal();
         } else {
           SearchManagerPerf::perf_failedLocalSteals++;
-          return nullptr;
         }
+        return nullptr;
       } else {
-        maybeStolen = getLocalWork(l);
+        maybeStolen = getLocalWork();
         if (!maybeStolen.empty()) {
           SearchManagerPerf::perf_localSteals++;
         } else {
@@ -258,7 +366,10 @@ struct SearchManager : public hpx::components::component_base<SearchManager> {
       }
 
       if (!maybeStolen.empty()) {
-        SearchManagerPerf::chunkSizeList.emplace_back(maybeStolen.size());
+        {
+          std::lock_guard<hpx::spinlock> l(statsMtx);
+          SearchManagerPerf::chunkSizeList.emplace_back(maybeStolen.size());
+        }
 
         // Take off the first task and queue up anything else that was returned
         auto first = maybeStolen[0];
@@ -270,8 +381,11 @@ struct SearchManager : public hpx::components::component_base<SearchManager> {
         for (itr; itr != maybeStolen.end(); ++itr) {
           taskBuffer.push_left(std::move(*itr));
         }
+        if (maybeStolen.size() > 1) {
+          Workstealing::Scheduler::notifyWork();
+        }
 
-        return hpx::bind(FuncToCall::fn_ptr(), searchInfo, depth, prom);
+        return hpx::bind(FuncToCall::fn_ptr(), ctx, searchInfo, depth, prom);
       }
 
       return nullptr;
@@ -279,29 +393,46 @@ struct SearchManager : public hpx::components::component_base<SearchManager> {
 
     // Signal the searchManager that a local thread is now finished working and should be removed from active
     void unregisterThread(unsigned activeId) {
-      std::lock_guard<MutexT> l(mtx);
-      if (active.find(activeId) != active.end()) {
-        active.erase(activeId);
-      } else {
-        // A steal must be in progress on this id so cancel it before finishing
-        // Canceled steals (-1 flag) are already removed from active
-        auto & state = inactive[activeId];
-        std::vector<Task> noSteal {hpx::make_tuple(SearchInfo(), -1, hpx::find_here())};
-        std::get<1>(*state).set(noSteal);
-        inactive.erase(activeId);
+      auto & slot = slots[activeId];
+      numActive--;
+
+      for (;;) {
+        unsigned expected = Active;
+        if (slot.state.compare_exchange_strong(expected, Claimed)) {
+          releaseSlot(slot);
+          return;
+        }
+
+        // A steal must be in progress on this id so cancel it before
+        // finishing, unless we already answered it. The thief frees the slot.
+        expected = Stealing;
+        if (slot.state.compare_exchange_strong(expected, Cancelled)) {
+          if (std::get<0>(*slot.stealReq).exchange(false)) {
+            std::vector<Task> noSteal {hpx::make_tuple(SearchInfo(), -1, hpx::find_here())};
+            std::get<1>(*slot.stealReq).set(noSteal);
+          }
+          return;
+        }
       }
-      activeIds.push(activeId);
     }
 
     // Generate a new stealRequest pair that can be used with an existing thread to add steals to it
-    // Used for master-threads initialising work while maintaining a stack
-    std::pair<std::shared_ptr<SharedState>, unsigned> registerThread() {
-      std::lock_guard<MutexT> l(mtx);
+    // Used for master-threads initialising work while maintaining a stack.
+    // If stack is given thieves steal from it directly rather than through
+    // the returned steal request (which is then never set).
+    std::pair<std::shared_ptr<SharedState>, unsigned> registerThread(std::shared_ptr<StealableStack<SearchInfo> > stack = nullptr) {
       auto shared_state = std::make_shared<SharedState>();
-      auto nextId = activeIds.front();
-      activeIds.pop();
-      active[nextId] = shared_state;
-      return std::make_pair(shared_state, nextId);
+      auto id = claimSlot();
+      auto & slot = slots[id];
+      slot.stealReq = shared_state;
+      slot.stack = std::move(stack);
+
+      numActive++;
+      slot.state.store(Active);
+
+      // Idle schedulers can now steal from this stack
+      Workstealing::Scheduler::notifyWork();
+      return std::make_pair(shared_state, id);
     }
 
     std::vector<hpx::id_type> getAllSearchManagers() {
@@ -315,17 +446,19 @@ struct SearchManager : public hpx::components::component_base<SearchManager> {
     typedef SharedState SharedState_t;
 
     // Helper function to setup the components/policies on each node and register required information
+    // (for the calling thread's search context)
     static void initPolicy() {
+      const auto ctx = YewPar::Context::current();
       std::vector<hpx::id_type> searchManagers;
       for (auto const& loc : hpx::find_all_localities()) {
         auto searchManager = hpx::new_<SearchManager>(loc).get();
-        hpx::async<InitComponentAct<SearchInfo, FuncToCall, Args...> >(searchManager).get();
+        hpx::async<InitComponentAct<SearchInfo, FuncToCall, Args...> >(searchManager, ctx).get();
         searchManagers.push_back(searchManager);
       }
 
       for (auto const & mgr : searchManagers) {
         using act = typename SearchManager::RegisterDistributedManagersAct<SearchInfo, FuncToCall, Args...>;
-        hpx::async<act>(mgr, searchManagers).get();
+        hpx::async<act>(mgr, ctx, searchManagers).get();
       }
     }
 
@@ -333,9 +466,9 @@ struct SearchManager : public hpx::components::component_base<SearchManager> {
 
   // Public component API (managing the types as required)
   template <typename SearchInfo, typename FuncToCall, typename ...Args>
-  void registerDistributedManagers(std::vector<hpx::id_type> distributedSearchMgrs) {
+  void registerDistributedManagers(YewPar::Context::Id ctx, std::vector<hpx::id_type> distributedSearchMgrs) {
     auto sm = std::static_pointer_cast<SearchManagerComp<SearchInfo, FuncToCall, Args...>>
-      (Workstealing::Scheduler::local_policy);
+      (Workstealing::Scheduler::getPolicy(ctx));
     sm->registerDistributedManagers(distributedSearchMgrs);
   }
   template <typename SearchInfo, typename FuncToCall, typename ...Args>
@@ -345,9 +478,16 @@ struct SearchManager : public hpx::components::component_base<SearchManager> {
     RegisterDistributedManagersAct<SearchInfo, FuncToCall, Args...> >::type {};
 
   template <typename SearchInfo, typename FuncToCall, typename ...Args>
-  typename SearchManagerComp<SearchInfo, FuncToCall, Args...>::Response_t getDistributedWork() {
+  typename SearchManagerComp<SearchInfo, FuncToCall, Args...>::Response_t getDistributedWork(YewPar::Context::Id ctx) {
     auto sm = std::static_pointer_cast<SearchManagerComp<SearchInfo, FuncToCall, Args...>>
-      (Workstealing::Scheduler::local_policy);
+      (Workstealing::Scheduler::getPolicy(ctx));
+    // The search may have finished here already
+    if (!sm) {
+      return {};
+    }
+    // Steals from passive stacks count the stolen task as created, so
+    // that has to happen in the thief's search, not the action's default
+    YewPar::Context::Scope scope(ctx);
     return sm->getDistributedWork();
   }
   template <typename SearchInfo, typename FuncToCall, typename ...Args>
@@ -0,0 +1,211 @@
+#include "WorkerDequePool.hpp"
+
+#include <hpx/functional/function.hpp>
+#include <hpx/modules/runtime_distributed.hpp>
+#include <hpx/performance_counters/manage_counter_type.hpp>
+
+#include <algorithm>
+#include <random>
+
+#include "util/util.hpp"
+
+namespace Workstealing { namespace Policies {
+
+namespace WorkerDequePoolPerf {
+
+std::atomic<std::uint64_t> perf_spawns(0);
+std::atomic<std::uint64_t> perf_localSteals(0);
+std::atomic<std::uint64_t> perf_distributedSteals(0);
+std::atomic<std::uint64_t> perf_failedLocalSteals(0);
+std::atomic<std::uint64_t> perf_failedDistributedSteals(0);
+
+std::uint64_t get_and_reset(std::atomic<std::uint64_t> & cntr, bool reset) {
+  auto res = cntr.load();
+  if (reset) { cntr = 0; }
+  return res;
+}
+
+std::uint64_t getSpawns (bool reset) { return get_and_reset(perf_spawns, reset);}
+std::uint64_t getLocalSteals(bool reset) { return get_and_reset(perf_localSteals, reset);}
+std::uint64_t getDistributedSteals (bool reset) { return get_and_reset(perf_distributedSteals, reset);}
+std::uint64_t getFailedLocalSteals(bool reset) { return get_and_reset(perf_failedLocalSteals, reset);}
+std::uint64_t getFailedDistributedSteals(bool reset) { return get_and_reset(perf_failedDistributedSteals, reset);}
+
+void registerPerformanceCounters() {
+  hpx::performance_counters::install_counter_type(
+      "/workstealing/WorkerDequePool/spawns",
+      &getSpawns,
+      "Returns the number of tasks spawned on this locality"
+                                                  );
+
+  hpx::performance_counters::install_counter_type(
+      "/workstealing/WorkerDequePool/localSteals",
+      &getLocalSteals,
+      "Returns the number of tasks stolen from another thread on the same locality"
+                                                  );
+
+  hpx::performance_counters::install_counter_type(
+      "/workstealing/WorkerDequePool/distributedSteals",
+      &getDistributedSteals,
+      "Returns the number of tasks stolen from another thread on another locality"
+                                                  );
+
+  hpx::performance_counters::install_counter_type(
+      "/workstealing/WorkerDequePool/localFailedSteals",
+      &getFailedLocalSteals,
+      "Returns the number of failed steals from this locality "
+                                                  );
+
+  hpx::performance_counters::install_counter_type(
+      "/workstealing/WorkerDequePool/distributedFailedSteals",
+      &getFailedDistributedSteals,
+      "Returns the number of failed steals from another locality "
+                                                  );
+}
+
+}
+
+namespace {
+
+std::mt19937 & threadRandGenerator() {
+  static thread_local std::mt19937 randGenerator(std::random_device{}());
+  return randGenerator;
+}
+
+}
+
+WorkerDequePool::WorkerDequePool(YewPar::Context::Id ctx)
+    : injected(std::make_shared<hpx::lockfree::deque<funcType> >()),
+      remote(WorkerDequePoolPerf::perf_distributedSteals, WorkerDequePoolPerf::perf_failedDistributedSteals, ctx) {
+  auto n = hpx::get_os_thread_count();
+  for (auto i = 0; i < n; ++i) {
+    deques.push_back(std::make_unique<workstealing::ChaseLevDeque<funcType> >());
+    localTiers.push_back(workstealing::workerTiers(i, n));
+  }
+  remote.setLocalPool([q = injected](auto t) { q->push_left(std::move(t)); });
+}
+
+std::size_t WorkerDequePool::myDeque() const {
+  // Returns std::size_t(-1) on non HPX worker threads
+  return std::min(hpx::get_worker_thread_num(), deques.size());
+}
+
+WorkerDequePool::funcType WorkerDequePool::trySteal(std::size_t victim) {
+  if (auto t = deques[victim]->steal()) {
+    std::unique_ptr<funcType> task(t);
+    return std::move(*task);
+  }
+  return nullptr;
+}
+
+WorkerDequePool::funcType WorkerDequePool::stealLocal(std::size_t self) {
+  if (self < deques.size()) {
+    // Sweep each tier from a random start so neighbours don't all pick the
+    // same victim
+    for (const auto & tier : localTiers[self]) {
+      if (tier.empty()) {
+        continue;
+      }
+      std::uniform_int_distribution<std::size_t> rand(0, tier.size() - 1);
+      const auto start = rand(threadRandGenerator());
+      for (auto i = 0; i < tier.size(); ++i) {
+        if (auto task = trySteal(tier[(start + i) % tier.size()])) {
+          return task;
+        }
+      }
+    }
+  } else {
+    // Remote thieves are equally far from every deque
+    const auto n = deques.size();
+    std::uniform_int_distribution<std::size_t> rand(0, n - 1);
+    const auto start = rand(threadRandGenerator());
+    for (auto i = 0; i < n; ++i) {
+      if (auto task = trySteal((start + i) % n)) {
+        return task;
+      }
+    }
+  }
+
+  funcType task;
+  if (injected->pop_right(task)) {
+    return task;
+  }
+
+  return nullptr;
+}
+
+std::vector<WorkerDequePool::funcType> WorkerDequePool::stealBatch() {
+  std::vector<funcType> res;
+
+  const auto n = deques.size();
+  std::uniform_int_distribution<std::size_t> rand(0, n - 1);
+  const auto start = rand(threadRandGenerator());
+  for (auto i = 0; i < n && res.size() < maxStealBatch; ++i) {
+    if (auto task = trySteal((start + i) % n)) {
+      res.push_back(std::move(task));
+    }
+  }
+
+  funcType task;
+  if (res.size() < maxStealBatch && injected->pop_right(task)) {
+    res.push_back(std::move(task));
+  }
+
+  return res;
+}
+
+hpx::function<void(), false> WorkerDequePool::getWork() {
+  const auto self = myDeque();
+
+  if (self < deques.size()) {
+    if (auto t = deques[self]->pop()) {
+      std::unique_ptr<funcType> task(t);
+      return hpx::bind(std::move(*task), hpx::find_here());
+    }
+  }
+
+  auto task = stealLocal(self);
+  if (task) {
+    WorkerDequePoolPerf::perf_localSteals++;
+    return hpx::bind(task, hpx::find_here());
+  } else {
+    WorkerDequePoolPerf::perf_failedLocalSteals++;
+  }
+
+  task = remote.pop();
+  remote.prefetch();
+  if (task) {
+    return hpx::bind(task, hpx::find_here());
+  }
+
+  return nullptr;
+}
+
+void WorkerDequePool::addwork(funcType task) {
+  WorkerDequePoolPerf::perf_spawns++;
+
+  const auto self = myDeque();
+  if (self < deques.size()) {
+    deques[self]->push(new funcType(std::move(task)));
+  } else {
+    injected->push_left(task);
+  }
+  Workstealing::Scheduler::notifyWork();
+}
+
+void WorkerDequePool::registerDistributedLocalities(std::vector<hpx::id_type> localities) {
+  localities.erase(
+      std::remove(localities.begin(), localities.end(), hpx::find_here()),
+      localities.end());
+
+  remote.setVictims(localities);
+}
+
+std::tuple<std::uint64_t, std::uint64_t, std::uint64_t> WorkerDequePool::getLoadCounters() {
+  using namespace WorkerDequePoolPerf;
+  return std::make_tuple(perf_spawns.load(),
+                         perf_localSteals.load() + perf_distributedSteals.load(),
+                         perf_failedLocalSteals.load() + perf_failedDistributedSteals.load());
+}
+
+}}
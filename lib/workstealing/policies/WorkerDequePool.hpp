@@ -0,0 +1,131 @@
+#ifndef YEWPAR_POLICY_WORKERDEQUEPOOL_HPP
+#define YEWPAR_POLICY_WORKERDEQUEPOOL_HPP
+
+#include "Policy.hpp"
+
+#include <hpx/include/components.hpp>
+#include <hpx/concurrency/deque.hpp>
+#include <hpx/runtime_distributed/find_all_localities.hpp>
+#include <hpx/modules/collectives.hpp>
+
+#include "workstealing/ChaseLevDeque.hpp"
+#include "workstealing/StealPrefetcher.hpp"
+#include "util/Context.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+namespace Workstealing { namespace Scheduler {
+std::shared_ptr<Policy> getPolicy(YewPar::Context::Id ctx);
+void setPolicy(YewPar::Context::Id ctx, std::shared_ptr<Policy> policy);
+void notifyWork();
+}}
+
+namespace Workstealing { namespace Policies {
+
+namespace WorkerDequePoolPerf {
+void registerPerformanceCounters();
+}
+
+// Drop in replacement for Workpool with one Chase-Lev deque per worker (OS)
+// thread rather than a single queue per locality. Spawns and local pops go
+// straight to the calling thread's deque, LIFO, without any actions or locks.
+// Idle threads steal the oldest task from the other deques on the locality,
+// nearest (by hardware topology) first, before trying other localities.
+// Other localities are stolen from asynchronously, a batch at a time, as in
+// Workpool.
+//
+// HPX threads only yield at suspension points, never inside a deque
+// operation, so all HPX threads running on one OS thread can share its deque
+// as the single owner.
+class WorkerDequePool : public Policy {
+ public:
+  using funcType = hpx::distributed::function<void(hpx::id_type)>;
+
+  struct stealRemote_act;
+
+ private:
+  std::vector<std::unique_ptr<workstealing::ChaseLevDeque<funcType> > > deques;
+
+  // Work added from outside the worker threads (there is no deque to own it),
+  // including the extra tasks of remote steal batches. Shared with steal
+  // continuations, which may outlive the policy.
+  std::shared_ptr<hpx::lockfree::deque<funcType> > injected;
+
+  // Other workers' deques nearest first (core, NUMA node, socket, rest), per
+  // worker thread
+  std::vector<std::vector<std::vector<std::size_t> > > localTiers;
+
+  // Other localities are stolen from in batches, in the background
+  workstealing::StealPrefetcher<stealRemote_act, YewPar::Context::Id> remote;
+
+  // Index of the calling thread's deque, or deques.size() if it has none
+  std::size_t myDeque() const;
+
+  funcType trySteal(std::size_t victim);
+
+  funcType stealLocal(std::size_t self);
+
+  // Up to one task from each deque (and the injected queue), at most
+  // maxStealBatch in all, so no owner loses all of its work
+  std::vector<funcType> stealBatch();
+
+  static constexpr std::size_t maxStealBatch = 32;
+
+ public:
+  explicit WorkerDequePool(YewPar::Context::Id ctx);
+  ~WorkerDequePool() = default;
+
+  hpx::function<void(), false> getWork() override;
+
+  void addwork(funcType task);
+
+  void registerDistributedLocalities(std::vector<hpx::id_type> localities);
+
+  // (spawns, successful steals, failed steals) on this locality since the
+  // counters were last reset. Lets skeletons tune task granularity to load.
+  static std::tuple<std::uint64_t, std::uint64_t, std::uint64_t> getLoadCounters();
+
+  static void setPolicy(YewPar::Context::Id ctx) {
+    Workstealing::Scheduler::setPolicy(ctx, std::make_shared<WorkerDequePool>(ctx));
+  }
+  struct setPolicy_act : hpx::actions::make_action<
+    decltype(&WorkerDequePool::setPolicy),
+    &WorkerDequePool::setPolicy,
+    setPolicy_act>::type {};
+
+  static void setDistributedLocalities(YewPar::Context::Id ctx, std::vector<hpx::id_type> localities) {
+    std::static_pointer_cast<WorkerDequePool>(Workstealing::Scheduler::getPolicy(ctx))->registerDistributedLocalities(localities);
+  }
+  struct setDistributedLocalities_act : hpx::actions::make_action<
+    decltype(&WorkerDequePool::setDistributedLocalities),
+    &WorkerDequePool::setDistributedLocalities,
+    setDistributedLocalities_act>::type {};
+
+  // Steal a batch on behalf of another locality
+  static std::vector<funcType> stealRemote(YewPar::Context::Id ctx) {
+    auto policy = std::static_pointer_cast<WorkerDequePool>(Workstealing::Scheduler::getPolicy(ctx));
+    // The search may have finished here already
+    if (!policy) {
+      return {};
+    }
+    return policy->stealBatch();
+  }
+  struct stealRemote_act : hpx::actions::make_action<
+    decltype(&WorkerDequePool::stealRemote),
+    &WorkerDequePool::stealRemote,
+    stealRemote_act>::type {};
+
+  // Set up the policy for the calling thread's search context
+  static void initPolicy() {
+    const auto ctx = YewPar::Context::current();
+    hpx::wait_all(hpx::lcos::broadcast<setPolicy_act>(hpx::find_all_localities(), ctx));
+    hpx::wait_all(hpx::lcos::broadcast<setDistributedLocalities_act>(hpx::find_all_localities(), ctx, hpx::find_all_localities()));
+  }
+};
+
+}}
+
+#endif
@@ -65,70 +65,57 @@ void registerPerformanceCounters() {
 
 }
 
-Workpool::Workpool(hpx::id_type localQueue) {
+Workpool::Workpool(hpx::id_type localQueue)
+    : remote(WorkpoolPerf::perf_distributedSteals, WorkpoolPerf::perf_failedDistributedSteals) {
   local_workqueue = localQueue;
-  last_remote = hpx::find_here();
-
-  std::random_device rd;
-  randGenerator.seed(rd());
+  local_workqueue_ptr = hpx::get_ptr<workstealing::Workqueue>(hpx::launch::sync, localQueue);
+  remote.setLocalPool([q = local_workqueue_ptr](auto t) { q->addWork(std::move(t)); });
 }
 
 hpx::function<void(), false> Workpool::getWork() {
-  std::unique_lock<mutex_t> l(mtx);
-
   hpx::distributed::function<void(hpx::id_type)> task;
-  task = hpx::async<workstealing::Workqueue::getLocal_action>(local_workqueue).get();
+  task = local_workqueue_ptr->getLocal();
 
   if (task) {
     WorkpoolPerf::perf_localSteals++;
+
+    // Running low, overlap remote steals with the work we have left
+    if (local_workqueue_ptr->size() < lowWater) {
+      remote.prefetch();
+    }
     return hpx::bind(task, hpx::find_here());
   } else {
     WorkpoolPerf::perf_failedLocalSteals++;
   }
 
-  if (!distributed_workqueues.empty()) {
-    // Last steal optimisation
-    if (last_remote != hpx::find_here()) {
-      task = hpx::async<workstealing::Workqueue::steal_action>(last_remote).get();
-      if (task) {
-        WorkpoolPerf::perf_distributedSteals++;
-        return hpx::bind(task, hpx::find_here());
-      } else {
-        WorkpoolPerf::perf_failedDistributedSteals++;
-        last_remote = hpx::find_here();
-      }
-    }
-
-    // If we fail the last steal then we try else where
-    std::uniform_int_distribution<int> rand(0, distributed_workqueues.size() - 1);
-    auto victim = distributed_workqueues.begin();
-    std::advance(victim, rand(randGenerator));
-    task = hpx::async<workstealing::Workqueue::steal_action>(*victim).get();
-
-    if (task) {
-      last_remote = *victim;
-      WorkpoolPerf::perf_distributedSteals++;
-      return hpx::bind(task, hpx::find_here());
-    } else {
-      WorkpoolPerf::perf_failedDistributedSteals++;
-    }
+  task = remote.pop();
+  remote.prefetch();
+  if (task) {
+    return hpx::bind(task, hpx::find_here());
   }
 
   return nullptr;
 }
 
 void Workpool::addwork(hpx::distributed::function<void(hpx::id_type)> task) {
-  std::unique_lock<mutex_t> l(mtx);
   WorkpoolPerf::perf_spawns++;
-  hpx::post<workstealing::Workqueue::addWork_action>(local_workqueue, task);
+  local_workqueue_ptr->addWork(std::move(task));
+  Workstealing::Scheduler::notifyWork();
 }
 
 void Workpool::registerDistributedWorkqueues(std::vector<hpx::id_type> workqueues) {
-  std::unique_lock<mutex_t> l(mtx);
-  distributed_workqueues = workqueues;
-  distributed_workqueues.erase(
-      std::remove_if(distributed_workqueues.begin(), distributed_workqueues.end(), YewPar::util::isColocated),
-      distributed_workqueues.end());
+  workqueues.erase(
+      std::remove_if(workqueues.begin(), workqueues.end(), YewPar::util::isColocated),
+      workqueues.end());
+
+  remote.setVictims(workqueues);
+}
+
+std::tuple<std::uint64_t, std::uint64_t, std::uint64_t> Workpool::getLoadCounters() {
+  using namespace WorkpoolPerf;
+  return std::make_tuple(perf_spawns.load(),
+                         perf_localSteals.load() + perf_distributedSteals.load(),
+                         perf_failedLocalSteals.load() + perf_failedDistributedSteals.load());
 }
 
 }}
@@ -7,11 +7,18 @@
 #include <hpx/modules/collectives.hpp>
 
 #include "workstealing/Workqueue.hpp"
+#include "workstealing/StealPrefetcher.hpp"
+#include "util/Context.hpp"
 
-#include <random>
+#include <cstdint>
+#include <tuple>
 #include <vector>
 
-namespace Workstealing { namespace Scheduler {extern std::shared_ptr<Policy> local_policy; }}
+namespace Workstealing { namespace Scheduler {
+std::shared_ptr<Policy> getPolicy(YewPar::Context::Id ctx);
+void setPolicy(YewPar::Context::Id ctx, std::shared_ptr<Policy> policy);
+void notifyWork();
+}}
 
 namespace Workstealing { namespace Policies {
 
@@ -22,17 +29,15 @@ void registerPerformanceCounters();
 class Workpool : public Policy {
 
  private:
-  // TODO: Pointer to local_workqueue instead of calling actions from the local version
   hpx::id_type local_workqueue;
-  hpx::id_type last_remote;
-  std::vector<hpx::id_type> distributed_workqueues;
-
-  // random number generator
-  std::mt19937 randGenerator;
+  // The local queue is always colocated so we call it directly. Actions are
+  // only used for remote victims.
+  std::shared_ptr<workstealing::Workqueue> local_workqueue_ptr;
+  // Remote queues are stolen from asynchronously into a local buffer
+  workstealing::StealPrefetcher<workstealing::Workqueue::stealBatch_action> remote;
 
-  // Policies must be thread safe (TODO: Push to PolicyBase?)
-  using mutex_t = hpx::mutex;
-  mutex_t mtx;
+  // Start stealing remotely once the local queue holds fewer tasks than this
+  static constexpr std::int64_t lowWater = 2;
 
  public:
   Workpool(hpx::id_type localQueue);
@@ -44,32 +49,38 @@ class Workpool : public Policy {
 
   void registerDistributedWorkqueues(std::vector<hpx::id_type> workqueues);
 
-  static void setWorkqueue(hpx::id_type localWorkqueue) {
-    Workstealing::Scheduler::local_policy = std::make_shared<Workpool>(localWorkqueue);
+  // (spawns, successful steals, failed steals) on this locality since the
+  // counters were last reset. Lets skeletons tune task granularity to load.
+  static std::tuple<std::uint64_t, std::uint64_t, std::uint64_t> getLoadCounters();
+
+  static void setWorkqueue(YewPar::Context::Id ctx, hpx::id_type localWorkqueue) {
+    Workstealing::Scheduler::setPolicy(ctx, std::make_shared<Workpool>(localWorkqueue));
   }
   struct setWorkqueue_act : hpx::actions::make_action<
     decltype(&Workpool::setWorkqueue),
     &Workpool::setWorkqueue,
     setWorkqueue_act>::type {};
 
-  static void setDistributedWorkqueues(std::vector<hpx::id_type> workqueues) {
-    std::static_pointer_cast<Workstealing::Policies::Workpool>(Workstealing::Scheduler::local_policy)->registerDistributedWorkqueues(workqueues);
+  static void setDistributedWorkqueues(YewPar::Context::Id ctx, std::vector<hpx::id_type> workqueues) {
+    std::static_pointer_cast<Workstealing::Policies::Workpool>(Workstealing::Scheduler::getPolicy(ctx))->registerDistributedWorkqueues(workqueues);
   }
   struct setDistributedWorkqueues_act : hpx::actions::make_action<
     decltype(&Workpool::setDistributedWorkqueues),
     &Workpool::setDistributedWorkqueues,
     setDistributedWorkqueues_act>::type {};
 
+  // Set up the policy for the calling thread's search context
   static void initPolicy() {
+    const auto ctx = YewPar::Context::current();
     std::vector<hpx::future<void> > futs;
     std::vector<hpx::id_type> workqueues;
     for (auto const& loc : hpx::find_all_localities()) {
       auto workqueue = hpx::new_<workstealing::Workqueue>(loc).get();
-      futs.push_back(hpx::async<setWorkqueue_act>(loc, workqueue));
+      futs.push_back(hpx::async<setWorkqueue_act>(loc, ctx, workqueue));
       workqueues.push_back(workqueue);
     }
     hpx::wait_all(futs);
-    hpx::wait_all(hpx::lcos::broadcast<setDistributedWorkqueues_act>(hpx::find_all_localities(), workqueues));
+    hpx::wait_all(hpx::lcos::broadcast<setDistributedWorkqueues_act>(hpx::find_all_localities(), ctx, workqueues));
   }
 };
 